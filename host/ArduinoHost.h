@@ -0,0 +1,75 @@
+/**
+ * Arduino core - Host shim
+ *
+ * This header declares the subset of the Arduino core used by the
+ * libraries, so they can be built on a Linux host. The functions run on
+ * the virtual clock and pins of the IR HAL's host backend (IRHalHost.cpp).
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _ARDUINO_HOST_H_
+#define _ARDUINO_HOST_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define _BV(bit) (1 << (bit))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t);
+void delayMicroseconds(unsigned int);
+
+/**
+ * Serial port stub. Output is discarded unless a stream is attached.
+ */
+class HostSerial {
+  public:
+    HostSerial() : out(0) {}
+    
+    void begin(long) {}
+    void attach(FILE *out) { this->out = out; }
+    int available() { return 0; }
+    int read() { return -1; }
+    
+    size_t write(uint8_t value) { if (this->out) fputc(value, this->out); return 1; }
+    size_t write(const uint8_t *data, size_t size) { if (this->out) fwrite(data, 1, size, this->out); return size; }
+    
+    void print(const char *text) { if (this->out) fputs(text, this->out); }
+    void print(long value) { if (this->out) fprintf(this->out, "%ld", value); }
+    void println() { this->print("\n"); }
+    void println(const char *text) { this->print(text); this->println(); }
+    void println(long value) { this->print(value); this->println(); }
+    
+  private:
+    FILE *out;
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * Capture File
+ *
+ * Read-only, memory-mapped view of a pulse capture recorded in the
+ * IRCapture format.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "CaptureFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaptureFile::CaptureFile()
+  : data(0),
+    size(0),
+    error(0)
+{
+}
+
+CaptureFile::~CaptureFile()
+{
+  this->close();
+}
+
+/**
+ * Maps a capture file and checks its header.
+ *
+ * @param path Path of the file
+ * @return Boolean indicating whether the file is a valid capture; see
+ *         getError() otherwise
+ */
+uint8_t CaptureFile::open(const char *path)
+{
+  struct stat st;
+  int fd;
+  
+  this->close();
+  
+  fd = ::open(path, O_RDONLY);
+  
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    this->error = "cannot open";
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return 0;
+  }
+  
+  if (st.st_size < IR_CAPTURE_HEADER_SIZE) {
+    this->error = "not a capture";
+    ::close(fd);
+    return 0;
+  }
+  
+  void *mapping = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  
+  if (mapping == MAP_FAILED) {
+    this->error = "cannot map";
+    return 0;
+  }
+  
+  this->data = (const uint8_t *)mapping;
+  this->size = st.st_size;
+  
+  if (!IRCapture::checkHeader(this->data, this->size)) {
+    this->close();
+    this->error = "not a capture";
+    return 0;
+  }
+  
+  madvise(mapping, this->size, MADV_SEQUENTIAL);
+  this->error = 0;
+  return 1;
+}
+
+/**
+ * Unmaps the file, if any.
+ */
+void CaptureFile::close()
+{
+  if (this->data) {
+    munmap((void *)this->data, this->size);
+    this->data = 0;
+    this->size = 0;
+  }
+}
+
+/**
+ * First pulse record of the capture
+ */
+const uint8_t *CaptureFile::begin()
+{
+  return this->data + IR_CAPTURE_HEADER_SIZE;
+}
+
+/**
+ * End of the capture
+ */
+const uint8_t *CaptureFile::end()
+{
+  return this->data + this->size;
+}
+
+/**
+ * Size of the file in bytes, header included
+ */
+uint64_t CaptureFile::getSize()
+{
+  return this->size;
+}
+
+/**
+ * Reason the last open() failed
+ */
+const char *CaptureFile::getError()
+{
+  return this->error;
+}
@@ -0,0 +1,44 @@
+/**
+ * Capture File
+ *
+ * Read-only, memory-mapped view of a pulse capture recorded in the
+ * IRCapture format.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _CAPTURE_FILE_H_
+#define _CAPTURE_FILE_H_
+
+#include <IR.h>
+#include <IRCapture.h>
+
+class CaptureFile {
+  public:
+    CaptureFile();
+    ~CaptureFile();
+    
+    uint8_t open(const char *);
+    void close();
+    
+    const uint8_t *begin();
+    const uint8_t *end();
+    uint64_t getSize();
+    const char *getError();
+    
+  private:
+    const uint8_t *data;
+    uint64_t size;
+    const char *error;
+    
+    CaptureFile(const CaptureFile &);
+    CaptureFile &operator=(const CaptureFile &);
+};
+
+#endif
@@ -0,0 +1,482 @@
+/**
+ * IR Hardware Abstraction Layer - Host backend
+ *
+ * This library emulates the subset of the Arduino core and the timers used
+ * by the IR libraries, so they can be built and benchmarked on a Linux host.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "IRHalHost.h"
+#include <IR.h>
+
+/**
+ * RX pin change scheduled by the simulation
+ */
+struct IRHostEdge {
+  uint64_t time;
+  uint8_t pin;
+  uint8_t level;
+};
+
+/**
+ * Complete state of the simulated board
+ */
+struct IRHostState {
+  uint64_t now;
+  
+  uint8_t pins[IR_HOST_PINS];
+  uint32_t rxMask;
+  uint8_t rxPin;
+  
+  IRHostEdge edges[IR_HOST_EDGE_QUEUE_SIZE];
+  uint16_t edgeHead;
+  uint16_t edgeCount;
+  
+  uint8_t carrierFrequency;
+  uint8_t carrierLevel;
+  uint8_t carrierRunning;
+  uint64_t carrierStartTime;
+  uint64_t carrierRunTime;
+  IRHost::CarrierListener carrierListener;
+  
+  uint8_t txTimerRunning;
+  uint8_t txTimerArmed;
+  uint64_t txCompareTick;
+  
+  uint8_t rxTimeoutArmed;
+  uint64_t rxTimeoutTick;
+  
+  uint32_t txInterrupts;
+  uint32_t rxInterrupts;
+  
+  uint8_t interruptsDisabled;
+  uint32_t readCost;
+  uint32_t interruptCost;
+};
+
+static IRHostState host;
+
+HostSerial Serial;
+
+/**
+ * Arduino core
+ */
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < IR_HOST_PINS && mode == INPUT_PULLUP) {
+    host.pins[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  if (pin < IR_HOST_PINS) {
+    host.pins[pin] = level ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < IR_HOST_PINS ? host.pins[pin] : LOW;
+}
+
+/**
+ * Charges the CPU time of a clock read (see IRHost::setCpuCost()). Pending
+ * interrupts fire during the read, unless they are disabled.
+ */
+static void chargeRead()
+{
+  if (!host.readCost) {
+    return;
+  }
+  
+  if (host.interruptsDisabled) {
+    host.now += host.readCost;
+  } else {
+    IRHost::runUntil(host.now + host.readCost);
+  }
+}
+
+uint32_t millis()
+{
+  chargeRead();
+  return (uint32_t)(host.now / 1000000);
+}
+
+uint32_t micros()
+{
+  chargeRead();
+  return (uint32_t)(host.now / 1000);
+}
+
+void delay(uint32_t ms)
+{
+  IRHost::advance((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  IRHost::advance((uint64_t)us * 1000);
+}
+
+/**
+ * Carrier. Only transitions are reported to the listener. Switching the LED
+ * on while the carrier generator is stopped emits nothing.
+ */
+void IRHal::carrierEnable(uint8_t khz)
+{
+  host.carrierFrequency = khz;
+  host.carrierLevel = 0;
+  host.carrierRunning = 0;
+}
+
+void IRHal::carrierStart()
+{
+  if (!host.carrierRunning) {
+    host.carrierRunning = 1;
+    host.carrierStartTime = host.now;
+  }
+}
+
+void IRHal::carrierStop()
+{
+  if (host.carrierRunning) {
+    host.carrierRunning = 0;
+    host.carrierRunTime += host.now - host.carrierStartTime;
+  }
+}
+
+void IRHal::carrierOn()
+{
+  if (!host.carrierLevel && host.carrierRunning) {
+    host.carrierLevel = 1;
+    
+    if (host.carrierListener) {
+      host.carrierListener(1, host.now);
+    }
+  }
+}
+
+void IRHal::carrierOff()
+{
+  if (host.carrierLevel) {
+    host.carrierLevel = 0;
+    
+    if (host.carrierListener) {
+      host.carrierListener(0, host.now);
+    }
+  }
+}
+
+/**
+ * TX timer. The compare time is kept as an absolute tick count; a 16-bit
+ * compare register moved by 0 ticks would match again after a full
+ * counter period.
+ */
+void IRHal::txTimerEnable()
+{
+  host.txTimerRunning = 1;
+  host.txTimerArmed = 0;
+}
+
+void IRHal::txTimerArm(uint16_t ticks)
+{
+  host.txTimerArmed = host.txTimerRunning;
+  host.txCompareTick = host.now / IR_HOST_NS_PER_TICK + ticks;
+}
+
+void IRHal::txTimerNext(uint16_t ticks)
+{
+  host.txCompareTick += ticks ? ticks : 0x10000;
+}
+
+uint16_t IRHal::txTimerCount()
+{
+  return (uint16_t)(host.now / IR_HOST_NS_PER_TICK);
+}
+
+uint16_t IRHal::txTimerCompare()
+{
+  return (uint16_t)host.txCompareTick;
+}
+
+void IRHal::txTimerDisarm()
+{
+  host.txTimerArmed = 0;
+}
+
+uint8_t IRHal::txTimerArmed()
+{
+  return host.txTimerArmed;
+}
+
+/**
+ * RX timeout, a second compare on the TX timer. The 16-bit tick is turned
+ * into the absolute tick at which the counter next reaches it.
+ */
+void IRHal::rxTimeoutArm(uint16_t tick)
+{
+  uint64_t count = host.now / IR_HOST_NS_PER_TICK;
+  uint16_t ticks = tick - (uint16_t)count;
+  
+  host.rxTimeoutArmed = 1;
+  host.rxTimeoutTick = count + (ticks ? ticks : 0x10000);
+}
+
+void IRHal::rxTimeoutDisarm()
+{
+  host.rxTimeoutArmed = 0;
+}
+
+uint8_t IRHal::rxTimeoutPending()
+{
+  return host.rxTimeoutArmed && host.rxTimeoutTick * IR_HOST_NS_PER_TICK <= host.now;
+}
+
+/**
+ * RX pin change interrupt
+ */
+void IRHal::rxEnable(uint8_t pin)
+{
+  if (pin < IR_HOST_PINS) {
+    host.rxMask |= 1UL << pin;
+    host.rxPin = pin;
+  }
+}
+
+uint8_t IRHal::rxRead()
+{
+  return host.pins[host.rxPin];
+}
+
+/**
+ * Interrupt flag. While it is cleared, interrupts due are held until it is
+ * set again and the clock next moves.
+ */
+uint8_t IRHal::disableInterrupts()
+{
+  uint8_t enabled = !host.interruptsDisabled;
+  
+  host.interruptsDisabled = 1;
+  return enabled;
+}
+
+void IRHal::restoreInterrupts(uint8_t enabled)
+{
+  host.interruptsDisabled = !enabled;
+}
+
+/**
+ * Sleeps until the next interrupt: a TX timer compare match, a scheduled
+ * RX edge, the RX timeout, or the next tick of the millis() timer. As in runUntil(), a
+ * compare match only fires once the clock has moved past it.
+ */
+void IRHal::sleep()
+{
+  uint64_t wake = (host.now / IR_HOST_NS_PER_MILLIS_TICK + 1) * IR_HOST_NS_PER_MILLIS_TICK;
+  
+  if (host.edgeCount && host.edges[host.edgeHead].time < wake) {
+    wake = host.edges[host.edgeHead].time;
+  }
+  
+  if (host.txTimerArmed && host.txCompareTick * IR_HOST_NS_PER_TICK < wake) {
+    wake = host.txCompareTick * IR_HOST_NS_PER_TICK + 1;
+  }
+  
+  if (host.rxTimeoutArmed && host.rxTimeoutTick * IR_HOST_NS_PER_TICK < wake) {
+    wake = host.rxTimeoutTick * IR_HOST_NS_PER_TICK + 1;
+  }
+  
+  host.interruptsDisabled = 0;
+  IRHost::runUntil(wake);
+}
+
+/**
+ * Puts the board back in its power-on state: time 0, all pins idle HIGH
+ * (the level of an IR receiver's output without a signal), no interrupt
+ * enabled and no pending edge.
+ */
+void IRHost::reset()
+{
+  CarrierListener listener = host.carrierListener;
+  
+  host = IRHostState();
+  host.carrierListener = listener;
+  
+  for (uint8_t pin = 0; pin < IR_HOST_PINS; ++pin) {
+    host.pins[pin] = HIGH;
+  }
+}
+
+/**
+ * Current virtual time, in nanoseconds
+ */
+uint64_t IRHost::now()
+{
+  return host.now;
+}
+
+/**
+ * Runs the simulation for the given number of nanoseconds.
+ */
+void IRHost::advance(uint64_t ns)
+{
+  IRHost::runUntil(host.now + ns);
+}
+
+/**
+ * Sets the CPU time charged to the code under test, so time also passes
+ * while it runs: each millis() or micros() call takes readNs, and entering
+ * an interrupt handler takes interruptNs. Both are 0 after reset(), which
+ * leaves the clock frozen outside of advance() and runUntil().
+ *
+ * @param readNs Cost of a clock read, in nanoseconds
+ * @param interruptNs Latency from an interrupt to its handler, in nanoseconds
+ */
+void IRHost::setCpuCost(uint32_t readNs, uint32_t interruptNs)
+{
+  host.readCost = readNs;
+  host.interruptCost = interruptNs;
+}
+
+/**
+ * Moves the virtual clock to the given time, firing every TX timer compare
+ * match, RX timeout and scheduled RX edge on the way, in order. A handler runs with
+ * interrupts disabled, so an interrupt due meanwhile fires once it returns.
+ *
+ * @param time Virtual time to stop at, in nanoseconds
+ */
+void IRHost::runUntil(uint64_t time)
+{
+  for (;;) {
+    uint64_t next = time;
+    uint8_t source = 0;
+    
+    if (host.edgeCount && host.edges[host.edgeHead].time <= next) {
+      next = host.edges[host.edgeHead].time;
+      source = 1;
+    }
+    
+    if (host.txTimerArmed && host.txCompareTick * IR_HOST_NS_PER_TICK < next) {
+      next = host.txCompareTick * IR_HOST_NS_PER_TICK;
+      source = 2;
+    }
+    
+    if (host.rxTimeoutArmed && host.rxTimeoutTick * IR_HOST_NS_PER_TICK < next) {
+      next = host.rxTimeoutTick * IR_HOST_NS_PER_TICK;
+      source = 3;
+    }
+    
+    if (next > host.now) {
+      host.now = next;
+    }
+    
+    if (source == 1) {
+      const IRHostEdge *edge = &host.edges[host.edgeHead];
+      uint8_t changed = host.pins[edge->pin] != edge->level;
+      
+      host.pins[edge->pin] = edge->level;
+      host.edgeHead = (host.edgeHead + 1) % IR_HOST_EDGE_QUEUE_SIZE;
+      --host.edgeCount;
+      
+      if (changed && (host.rxMask & (1UL << edge->pin))) {
+        ++host.rxInterrupts;
+        host.interruptsDisabled = 1;
+        host.now += host.interruptCost;
+        IR::handleRxInterrupt();
+        host.interruptsDisabled = 0;
+      }
+    } else if (source == 2) {
+      ++host.txInterrupts;
+      host.interruptsDisabled = 1;
+      host.now += host.interruptCost;
+      IR::handleTxInterrupt();
+      host.interruptsDisabled = 0;
+    } else if (source == 3) {
+      host.interruptsDisabled = 1;
+      host.now += host.interruptCost;
+      IR::handleRxTimeoutInterrupt();
+      host.interruptsDisabled = 0;
+    } else {
+      return;
+    }
+  }
+}
+
+/**
+ * Schedules a level change of an input pin. Edges must be scheduled in
+ * chronological order.
+ *
+ * @param time Virtual time of the change, in nanoseconds
+ * @param pin Pin to change
+ * @param level New level of the pin
+ * @return Boolean indicating whether the edge was queued
+ */
+uint8_t IRHost::scheduleEdge(uint64_t time, uint8_t pin, uint8_t level)
+{
+  if (host.edgeCount == IR_HOST_EDGE_QUEUE_SIZE || pin >= IR_HOST_PINS) {
+    return 0;
+  }
+  
+  IRHostEdge *edge = &host.edges[(host.edgeHead + host.edgeCount) % IR_HOST_EDGE_QUEUE_SIZE];
+  edge->time = time;
+  edge->pin = pin;
+  edge->level = level ? HIGH : LOW;
+  ++host.edgeCount;
+  
+  return 1;
+}
+
+/**
+ * Number of scheduled edges that have not fired yet
+ */
+uint16_t IRHost::pendingEdges()
+{
+  return host.edgeCount;
+}
+
+/**
+ * Registers the function called on every carrier transition.
+ */
+void IRHost::setCarrierListener(CarrierListener listener)
+{
+  host.carrierListener = listener;
+}
+
+uint8_t IRHost::carrierLevel()
+{
+  return host.carrierLevel;
+}
+
+uint8_t IRHost::carrierFrequency()
+{
+  return host.carrierFrequency;
+}
+
+/**
+ * Time the carrier generator has been running since reset(), in nanoseconds
+ */
+uint64_t IRHost::carrierRunTime()
+{
+  return host.carrierRunTime + (host.carrierRunning ? host.now - host.carrierStartTime : 0);
+}
+
+/**
+ * Number of TX timer / RX pin change interrupts fired since reset()
+ */
+uint32_t IRHost::txInterrupts()
+{
+  return host.txInterrupts;
+}
+
+uint32_t IRHost::rxInterrupts()
+{
+  return host.rxInterrupts;
+}
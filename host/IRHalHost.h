@@ -0,0 +1,114 @@
+/**
+ * IR Hardware Abstraction Layer - Host backend
+ *
+ * This library emulates the subset of the Arduino core (declared in
+ * ArduinoHost.h) and the timers used by the IR libraries, so they can be
+ * built and benchmarked on a Linux host. Time is virtual and
+ * deterministic: it only moves when IRHost::advance(), IRHost::runUntil()
+ * or IRHal::sleep() is called, and interrupts fire at exact times.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_HAL_HOST_H_
+#define _IR_HAL_HOST_H_
+
+#include <ArduinoHost.h>
+#include <inttypes.h>
+
+/**
+ * Number of simulated digital pins
+ */
+#define IR_HOST_PINS 20
+
+/**
+ * Number of RX edges that can be scheduled ahead of the virtual clock
+ */
+#ifndef IR_HOST_EDGE_QUEUE_SIZE
+#define IR_HOST_EDGE_QUEUE_SIZE 1024
+#endif
+
+/**
+ * Length of one TX timer tick in nanoseconds (TIMER1 at SYSCLOCK / 8)
+ */
+#define IR_HOST_NS_PER_TICK 500
+
+/**
+ * Period of the millis() timer's overflow interrupt in nanoseconds, which
+ * wakes the CPU from sleep (TIMER0 at SYSCLOCK / 64 on the AVR)
+ */
+#define IR_HOST_NS_PER_MILLIS_TICK 1024000
+
+/**
+ * Hardware interface used by the IR libraries (see IRHal.h). The carrier is
+ * modelled as a level on the TX pin, the TX timer as a 16-bit counter
+ * derived from the virtual clock. Interrupts only fire from within
+ * IRHost::runUntil(), which clock reads also call once a CPU cost is set
+ * (see IRHost::setCpuCost()); disableInterrupts() holds them back.
+ */
+class IRHal {
+  public:
+    static void carrierEnable(uint8_t);
+    static void carrierStart();
+    static void carrierStop();
+    static void carrierOn();
+    static void carrierOff();
+    
+    static void txTimerEnable();
+    static void txTimerArm(uint16_t);
+    static void txTimerNext(uint16_t);
+    static uint16_t txTimerCount();
+    static uint16_t txTimerCompare();
+    static void txTimerDisarm();
+    static uint8_t txTimerArmed();
+    
+    static void rxEnable(uint8_t);
+    static uint8_t rxRead();
+    static void rxTimeoutArm(uint16_t);
+    static void rxTimeoutDisarm();
+    static uint8_t rxTimeoutPending();
+    
+    static uint8_t disableInterrupts();
+    static void restoreInterrupts(uint8_t);
+    
+    static void sleep();
+};
+
+/**
+ * Control of the simulation: the virtual clock, the RX pin stimulus and the
+ * observation of the carrier.
+ */
+class IRHost {
+  public:
+    /**
+     * Called on every carrier transition, with the new level and the time
+     * of the transition in nanoseconds.
+     */
+    typedef void (*CarrierListener)(uint8_t, uint64_t);
+    
+    static void reset();
+    static uint64_t now();
+    
+    static void setCpuCost(uint32_t, uint32_t);
+    static void advance(uint64_t);
+    static void runUntil(uint64_t);
+    
+    static uint8_t scheduleEdge(uint64_t, uint8_t, uint8_t);
+    static uint16_t pendingEdges();
+    
+    static void setCarrierListener(CarrierListener);
+    static uint8_t carrierLevel();
+    static uint8_t carrierFrequency();
+    static uint64_t carrierRunTime();
+    
+    static uint32_t txInterrupts();
+    static uint32_t rxInterrupts();
+};
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * IR Batch
+ *
+ * Decodes a corpus of pulse captures (see IRCapture.h) on every core of the
+ * host. Capture files are handed out to a pool of worker threads one at a
+ * time; each worker runs its own Gyropter and Air Swimmer decoders, so the
+ * workers share nothing but the index of the next file.
+ *
+ * For each capture, a line with its pulse and frame counts and its error
+ * rate is printed, in the order the files were given; an error is a burst
+ * of pulses long enough to be a frame that no decoder accepted. Totals
+ * follow as one "name value" pair per line. With -o, the decoded frames
+ * of each capture are written to <dir>/<capture name>.frames, one
+ * "<pulse index> <protocol> <packet>" line per frame.
+ *
+ * Usage: ir_batch [-j threads] [-o dir] capture|directory...
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include <IR.h>
+#include <IRCapture.h>
+#include <IRMultiDecoder.h>
+#include <GyropterIR.h>
+#include <AirSwimmerIR.h>
+#include "CaptureFile.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A HIGH pulse (receiver idle) longer than this ends a burst. It is longer
+ * than any gap inside a Gyropter or Air Swimmer frame.
+ */
+#define BATCH_IDLE_US 4000
+
+/**
+ * Bursts with fewer pulses than this are noise, not failed frames
+ */
+#define BATCH_MIN_BURST 16
+
+/**
+ * Decoding results of one capture
+ */
+struct BatchResult {
+  std::string path;
+  const char *error;
+  uint64_t pulses;
+  uint64_t frames[AIRSWIMMER_IR_PROTOCOL + 1];
+  uint64_t bursts;
+  uint64_t failedBursts;
+};
+
+/**
+ * Work shared by the worker threads
+ */
+struct BatchJob {
+  std::vector<BatchResult> results;
+  std::atomic<size_t> next;
+  const char *outputDir;
+};
+
+static uint64_t batchClock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Opens the frame list of a capture in the output directory
+ */
+static FILE *batchOpenOutput(const char *dir, const std::string &path)
+{
+  std::string name = path.substr(path.find_last_of('/') + 1);
+  std::string output = std::string(dir) + "/" + name + ".frames";
+  
+  return fopen(output.c_str(), "w");
+}
+
+/**
+ * Decodes one capture with fresh decoders.
+ */
+static void batchDecode(BatchResult *result, const char *outputDir)
+{
+  IRProtocolDecoder<GyropterIRProtocol> gyropterDecoder;
+  IRProtocolDecoder<AirSwimmerIRProtocol> airSwimmerDecoder;
+  IRMultiDecoder decoder;
+  CaptureFile capture;
+  FILE *out = 0;
+  
+  decoder.add(&gyropterDecoder, GYROPTER_IR_PROTOCOL);
+  decoder.add(&airSwimmerDecoder, AIRSWIMMER_IR_PROTOCOL);
+  
+  if (!capture.open(result->path.c_str())) {
+    result->error = capture.getError();
+    return;
+  }
+  
+  if (outputDir && !(out = batchOpenOutput(outputDir, result->path))) {
+    result->error = "cannot write frames";
+    return;
+  }
+  
+  const uint8_t *p = capture.begin();
+  const uint8_t *end = capture.end();
+  uint32_t burstPulses = 0;
+  uint32_t burstFrames = 0;
+  uint16_t pulse;
+  IRFrame frame;
+  
+  uint8_t ended = 0;
+  
+  // The last packet is only framed by the idle gap that follows it, which
+  // the capture does not contain: a saturated gap is fed at its end, until
+  // no frame is left pending in the decoders
+  while (!ended) {
+    if (IRCapture::decode(&p, end, &pulse)) {
+      ++result->pulses;
+    } else {
+      pulse = IR_PULSE_LEVEL | IR_PULSE_WIDTH;
+      ended = 1;
+    }
+    
+    if (decoder.decode(pulse, &frame)) {
+      ++burstFrames;
+      ended = 0;
+      
+      if (frame.protocol <= AIRSWIMMER_IR_PROTOCOL) {
+        ++result->frames[frame.protocol];
+      }
+      
+      if (out) {
+        fprintf(out, "%llu %u 0x%06lx\n", (unsigned long long)result->pulses - 1,
+          frame.protocol, (unsigned long)frame.packet);
+      }
+    }
+    
+    if ((pulse & IR_PULSE_LEVEL) && (pulse & IR_PULSE_WIDTH) > BATCH_IDLE_US) {
+      if (burstPulses >= BATCH_MIN_BURST) {
+        ++result->bursts;
+        
+        if (!burstFrames) {
+          ++result->failedBursts;
+        }
+      }
+      
+      burstPulses = 0;
+      burstFrames = 0;
+    } else {
+      ++burstPulses;
+    }
+  }
+  
+  if (out) {
+    fclose(out);
+  }
+}
+
+/**
+ * Worker thread: decodes captures until none is left.
+ */
+static void batchWorker(BatchJob *job)
+{
+  size_t index;
+  
+  while ((index = job->next.fetch_add(1)) < job->results.size()) {
+    batchDecode(&job->results[index], job->outputDir);
+  }
+}
+
+/**
+ * Adds a capture, or every file of a directory (sorted by name), to the job.
+ */
+static void batchAdd(BatchJob *job, const char *path)
+{
+  struct stat st;
+  BatchResult result = BatchResult();
+  
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+    std::vector<std::string> names;
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    
+    while (dir && (entry = readdir(dir))) {
+      std::string name = std::string(path) + "/" + entry->d_name;
+      
+      if (stat(name.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        names.push_back(name);
+      }
+    }
+    
+    if (dir) {
+      closedir(dir);
+    }
+    
+    std::sort(names.begin(), names.end());
+    
+    for (size_t i = 0; i < names.size(); ++i) {
+      result.path = names[i];
+      job->results.push_back(result);
+    }
+  } else {
+    result.path = path;
+    job->results.push_back(result);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned threads = std::thread::hardware_concurrency();
+  BatchJob job;
+  
+  job.next = 0;
+  job.outputDir = 0;
+  
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = strtoul(argv[++i], 0, 0);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      job.outputDir = argv[++i];
+    } else {
+      batchAdd(&job, argv[i]);
+    }
+  }
+  
+  if (job.results.empty()) {
+    fprintf(stderr, "usage: %s [-j threads] [-o dir] capture|directory...\n", argv[0]);
+    return 2;
+  }
+  
+  if (threads == 0) {
+    threads = 1;
+  }
+  if (threads > job.results.size()) {
+    threads = job.results.size();
+  }
+  
+  uint64_t start = batchClock();
+  std::vector<std::thread> workers;
+  
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.push_back(std::thread(batchWorker, &job));
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    workers[i].join();
+  }
+  
+  uint64_t elapsed = batchClock() - start;
+  uint64_t pulses = 0;
+  uint64_t frames = 0;
+  uint64_t bursts = 0;
+  uint64_t failedBursts = 0;
+  int failures = 0;
+  
+  for (size_t i = 0; i < job.results.size(); ++i) {
+    const BatchResult *r = &job.results[i];
+    
+    if (r->error) {
+      fprintf(stderr, "%s: %s\n", r->path.c_str(), r->error);
+      ++failures;
+      continue;
+    }
+    
+    printf("file %s pulses %llu gyropter %llu airswimmer %llu bursts %llu errors %llu error_rate %.6f\n",
+      r->path.c_str(),
+      (unsigned long long)r->pulses,
+      (unsigned long long)r->frames[GYROPTER_IR_PROTOCOL],
+      (unsigned long long)r->frames[AIRSWIMMER_IR_PROTOCOL],
+      (unsigned long long)r->bursts,
+      (unsigned long long)r->failedBursts,
+      r->bursts ? (double)r->failedBursts / r->bursts : 0.0);
+    
+    pulses += r->pulses;
+    frames += r->frames[GYROPTER_IR_PROTOCOL] + r->frames[AIRSWIMMER_IR_PROTOCOL];
+    bursts += r->bursts;
+    failedBursts += r->failedBursts;
+  }
+  
+  printf("batch_files %llu\n", (unsigned long long)job.results.size());
+  printf("batch_threads %u\n", threads);
+  printf("batch_pulses %llu\n", (unsigned long long)pulses);
+  printf("batch_frames %llu\n", (unsigned long long)frames);
+  printf("batch_error_rate %.6f\n", bursts ? (double)failedBursts / bursts : 0.0);
+  printf("batch_seconds %.3f\n", elapsed / 1e9);
+  printf("batch_frames_per_second %.0f\n", elapsed ? frames * 1e9 / elapsed : 0.0);
+  
+  return failures ? 1 : 0;
+}
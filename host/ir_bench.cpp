@@ -0,0 +1,1195 @@
+/**
+ * IR Benchmark
+ *
+ * Host benchmark of the IR libraries. Measures the decode throughput of the
+ * protocol decoders, then runs the augmented_air_swimmer sketch against the
+ * simulated board: Gyropter frames are played into the RX pin, and the
+ * Air Swimmer frames coming out of the TX carrier are timed and decoded.
+ *
+ * Results are printed as one "name value" pair per line. The exit status is
+ * non-zero when a frame is lost or a TX edge is off its nominal width.
+ *
+ * Usage: ir_bench [decode frames] [sketch frames]
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "../sketches/augmented_air_swimmer/augmented_air_swimmer.ino"
+#include <AirSwimmerFleet.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Longest pulse sequence generated for one frame of the given length, and
+ * for the frames of up to 32 bits
+ */
+#define BENCH_PULSES(bits) (2 * (bits) + 4)
+#define BENCH_MAX_PULSES BENCH_PULSES(32)
+
+/**
+ * Virtual time between two passes of the sketch's main loop, in nanoseconds
+ */
+#define BENCH_LOOP_PERIOD 250000ULL
+
+/**
+ * Virtual time charged for a pass of the sketch's main loop that ran a task
+ * (the sketch sleeps through the others), in nanoseconds
+ */
+#define BENCH_TASK_COST 50000ULL
+
+/**
+ * Virtual time spent awake between two sleeps of the power bench, in
+ * nanoseconds
+ */
+#define BENCH_POWER_AWAKE 100000ULL
+
+/**
+ * CPU time charged for a clock read and for entering an interrupt handler
+ * in the sketch simulation, in nanoseconds (see IRHost::setCpuCost()). They
+ * are close to the AVR core's micros() and to an interrupt's entry with the
+ * registers saved.
+ */
+#define BENCH_READ_COST      4000
+#define BENCH_INTERRUPT_COST 2000
+
+/**
+ * Largest error allowed on the width of a TX interval, in nanoseconds
+ */
+#define BENCH_TX_TOLERANCE (IR_TX_LATE_TICKS * IR_HOST_NS_PER_TICK)
+
+static uint32_t benchSeed = 0x2545F491;
+
+// Oscillator drift applied to generated pulses, in parts per thousand
+static int32_t benchDriftPermille = 0;
+
+/**
+ * Deterministic pseudo-random numbers (xorshift32), so every run replays
+ * the same frames.
+ */
+static uint32_t benchRandom()
+{
+  benchSeed ^= benchSeed << 13;
+  benchSeed ^= benchSeed >> 17;
+  benchSeed ^= benchSeed << 5;
+  return benchSeed;
+}
+
+/**
+ * Monotonic wall-clock time, in nanoseconds
+ */
+static uint64_t benchClock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Random Gyropter packet. Bit 1 is always 0.
+ */
+static uint32_t benchGyropterPacket()
+{
+  return benchRandom() & 0x1FFFFD;
+}
+
+/**
+ * Random Air Swimmer packet for the default signature
+ */
+static uint32_t benchAirSwimmerPacket()
+{
+  uint8_t commands = benchRandom() & 0xF;
+  
+  return ((uint32_t)AIRSWIMMER_IR_SIGNATURE << 8)
+    | (commands << 4)
+    | (commands ^ AIRSWIMMER_IR_CHECKSUM_BASE);
+}
+
+/**
+ * Appends a pulse as captured by IRPulseBuffer, with up to half the
+ * protocol's tolerance of random jitter.
+ */
+template <class Protocol>
+static uint16_t *benchPulse(uint16_t *pulse, uint8_t level, uint32_t width)
+{
+  int32_t jitter = (int32_t)(benchRandom() % (Protocol::pulseTolerance + 1)) - Protocol::pulseTolerance / 2;
+  
+  width = width * (1000 + benchDriftPermille) / 1000 + jitter;
+  
+  if (width > IR_PULSE_WIDTH) {
+    width = IR_PULSE_WIDTH;
+  }
+  
+  *pulse = (level == HIGH ? IR_PULSE_LEVEL : 0) | (uint16_t)width;
+  return pulse + 1;
+}
+
+/**
+ * Bit of a packet (see IR_PACKET_WORDS), counted from the first bit sent
+ */
+static uint8_t benchBit(const uint32_t *packet, uint8_t bits, uint8_t bit)
+{
+  uint8_t word = bit / 32;
+  uint8_t width = word < (bits - 1) / 32 ? 32 : bits - 32 * word;
+  
+  return (packet[word] >> (width - 1 - bit % 32)) & 1;
+}
+
+/**
+ * Encodes a packet into the pulses seen at the receiver's output, in the
+ * same sequence as IRProtocol::tx(), followed by the protocol's idle gap.
+ *
+ * @param packet Packet to encode
+ * @param pulses Output buffer, of at least BENCH_PULSES(packetBits) pulses
+ * @return Number of pulses
+ */
+template <class Protocol>
+static uint8_t benchEncode(const uint32_t *packet, uint16_t *pulses)
+{
+  const uint8_t pulseLevel = Protocol::pulseInType;
+  const uint8_t gapLevel = !pulseLevel;
+  uint16_t *pulse = pulses;
+  
+  if (Protocol::startPulseDuration) {
+    pulse = benchPulse<Protocol>(pulse, gapLevel, Protocol::pulseGapDuration);
+    pulse = benchPulse<Protocol>(pulse, pulseLevel, Protocol::startPulseDuration);
+  }
+  
+  for (uint8_t bit = 0; bit < Protocol::packetBits; ++bit) {
+    pulse = benchPulse<Protocol>(pulse, gapLevel, Protocol::pulseGapDuration);
+    pulse = benchPulse<Protocol>(pulse, pulseLevel, benchBit(packet, Protocol::packetBits, bit)
+      ? Protocol::longPulseDuration : Protocol::shortPulseDuration);
+  }
+  
+  pulse = benchPulse<Protocol>(pulse, gapLevel, Protocol::gapDuration);
+  
+  return pulse - pulses;
+}
+
+/**
+ * Pre-encoded frames, so the timed loops only measure decoding
+ */
+struct BenchFrame {
+  uint8_t protocol;
+  uint32_t packet;
+  uint8_t pulseCount;
+  uint16_t pulses[BENCH_MAX_PULSES];
+};
+
+static BenchFrame *benchFrames(uint32_t count, uint8_t mixed)
+{
+  BenchFrame *frames = (BenchFrame *)malloc(count * sizeof(BenchFrame));
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    BenchFrame *f = &frames[i];
+    
+    if (mixed && (benchRandom() & 1)) {
+      f->protocol = AIRSWIMMER_IR_PROTOCOL;
+      f->packet = benchAirSwimmerPacket();
+      f->pulseCount = benchEncode<AirSwimmerIRProtocol>(&f->packet, f->pulses);
+    } else {
+      f->protocol = GYROPTER_IR_PROTOCOL;
+      f->packet = benchGyropterPacket();
+      f->pulseCount = benchEncode<GyropterIRProtocol>(&f->packet, f->pulses);
+    }
+  }
+  
+  return frames;
+}
+
+static void benchReport(const char *name, double value)
+{
+  printf("%s %.3f\n", name, value);
+}
+
+static void benchReport(const char *name, uint64_t value)
+{
+  printf("%s %llu\n", name, (unsigned long long)value);
+}
+
+/**
+ * Throughput of a single protocol decoder
+ *
+ * @return Number of frames lost
+ */
+static uint32_t benchDecode(uint32_t count)
+{
+  BenchFrame *frames = benchFrames(count, 0);
+  IRProtocolDecoder<GyropterIRProtocol> decoder;
+  uint64_t pulses = 0;
+  uint32_t decoded = 0;
+  uint32_t packet;
+  
+  uint64_t start = benchClock();
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    const BenchFrame *f = &frames[i];
+    
+    for (uint8_t p = 0; p < f->pulseCount; ++p) {
+      if (decoder.decode(f->pulses[p], &packet) && packet == f->packet) {
+        ++decoded;
+      }
+    }
+    
+    pulses += f->pulseCount;
+  }
+  
+  uint64_t elapsed = benchClock() - start;
+  
+  benchReport("gyropter_decode_frames", (uint64_t)count);
+  benchReport("gyropter_decode_ok", (uint64_t)decoded);
+  benchReport("gyropter_decode_ns_per_frame", (double)elapsed / count);
+  benchReport("gyropter_decode_ns_per_pulse", (double)elapsed / pulses);
+  
+  free(frames);
+  return count - decoded;
+}
+
+/**
+ * Throughput of the multi decoder, on interleaved Gyropter and
+ * Air Swimmer frames
+ *
+ * @return Number of frames lost
+ */
+static uint32_t benchMultiDecode(uint32_t count)
+{
+  BenchFrame *frames = benchFrames(count, 1);
+  IRProtocolDecoder<GyropterIRProtocol> gyropterDecoder;
+  IRProtocolDecoder<AirSwimmerIRProtocol> airSwimmerDecoder;
+  IRMultiDecoder decoder;
+  IRFrame decodedFrame;
+  uint64_t pulses = 0;
+  uint32_t decoded = 0;
+  
+  decoder.add(&gyropterDecoder, GYROPTER_IR_PROTOCOL);
+  decoder.add(&airSwimmerDecoder, AIRSWIMMER_IR_PROTOCOL);
+  
+  uint64_t start = benchClock();
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    const BenchFrame *f = &frames[i];
+    
+    for (uint8_t p = 0; p < f->pulseCount; ++p) {
+      if (decoder.decode(f->pulses[p], &decodedFrame)
+          && decodedFrame.protocol == f->protocol
+          && decodedFrame.packet == f->packet) {
+        ++decoded;
+      }
+    }
+    
+    pulses += f->pulseCount;
+  }
+  
+  uint64_t elapsed = benchClock() - start;
+  
+  benchReport("multi_decode_frames", (uint64_t)count);
+  benchReport("multi_decode_ok", (uint64_t)decoded);
+  benchReport("multi_decode_ns_per_frame", (double)elapsed / count);
+  benchReport("multi_decode_ns_per_pulse", (double)elapsed / pulses);
+  
+  free(frames);
+  return count - decoded;
+}
+
+/**
+ * Gyropter timings without pulse width tracking
+ */
+struct GyropterFixedIRProtocol : GyropterIRProtocol {
+  static const uint16_t trackingTolerance = 0;
+};
+
+/**
+ * Decodes frames from a remote whose oscillator slowly drifts up to the
+ * given rate, with and without pulse width tracking.
+ *
+ * @return Number of frames lost by the tracking decoder
+ */
+static uint32_t benchDrift(uint32_t count, int32_t maxPermille)
+{
+  IRProtocolDecoder<GyropterIRProtocol> tracking;
+  IRProtocolDecoder<GyropterFixedIRProtocol> fixed;
+  uint16_t pulses[BENCH_MAX_PULSES];
+  uint32_t trackingOk = 0;
+  uint32_t fixedOk = 0;
+  uint32_t packet;
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t sent = benchGyropterPacket();
+    
+    benchDriftPermille = (int64_t)maxPermille * i / count;
+    uint8_t pulseCount = benchEncode<GyropterIRProtocol>(&sent, pulses);
+    
+    for (uint8_t p = 0; p < pulseCount; ++p) {
+      if (tracking.decode(pulses[p], &packet) && packet == sent) {
+        ++trackingOk;
+      }
+      if (fixed.decode(pulses[p], &packet) && packet == sent) {
+        ++fixedOk;
+      }
+    }
+  }
+  
+  benchDriftPermille = 0;
+  
+  benchReport("drift_frames", (uint64_t)count);
+  benchReport("drift_max_permille", (uint64_t)maxPermille);
+  benchReport("drift_tracking_ok", (uint64_t)trackingOk);
+  benchReport("drift_fixed_ok", (uint64_t)fixedOk);
+  benchReport("drift_tracking_long_us", (uint64_t)tracking.getPulseWidth(IR_SYMBOL_ONE));
+  benchReport("drift_tracking_locked", (uint64_t)tracking.isLocked());
+  
+  return count - trackingOk;
+}
+
+/**
+ * Decodes Gyropter frames whose start pulse is, in turn, intact,
+ * distorted beyond the start window, or lost altogether.
+ *
+ * @return Number of frames lost
+ */
+static uint32_t benchSync(uint32_t count)
+{
+  IRProtocolDecoder<GyropterIRProtocol> decoder;
+  uint16_t pulses[BENCH_MAX_PULSES];
+  uint32_t decoded[3] = {0, 0, 0};
+  uint32_t packet;
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t sent = benchGyropterPacket();
+    uint8_t pulseCount = benchEncode<GyropterIRProtocol>(&sent, pulses);
+    uint8_t first = 0;
+    uint8_t variant = i % 3;
+    
+    if (variant == 1) {
+      pulses[1] = (pulses[1] & IR_PULSE_LEVEL) | 3500;
+    } else if (variant == 2) {
+      first = 2;
+    }
+    
+    for (uint8_t p = first; p < pulseCount; ++p) {
+      if (decoder.decode(pulses[p], &packet) && packet == sent) {
+        ++decoded[variant];
+      }
+    }
+  }
+  
+  benchReport("sync_frames", (uint64_t)count);
+  benchReport("sync_start_ok", (uint64_t)decoded[0]);
+  benchReport("sync_distorted_start_ok", (uint64_t)decoded[1]);
+  benchReport("sync_lost_start_ok", (uint64_t)decoded[2]);
+  
+  return count - decoded[0] - decoded[1] - decoded[2];
+}
+
+/**
+ * Air Swimmer timings without the signature check
+ */
+struct AirSwimmerUncheckedIRProtocol : AirSwimmerIRProtocol {
+  static const uint8_t signatureBits = 0;
+};
+
+/**
+ * Decodes Air Swimmer frames, each run into by up to a packet's worth of
+ * noise bits with no idle gap in between, with and without the signature
+ * check.
+ *
+ * @return Number of frames lost by the checking decoder
+ */
+static uint32_t benchNoise(uint32_t count)
+{
+  IRProtocolDecoder<AirSwimmerIRProtocol> checked;
+  IRProtocolDecoder<AirSwimmerUncheckedIRProtocol> unchecked;
+  uint16_t pulses[BENCH_MAX_PULSES + 2 * AirSwimmerIRProtocol::packetBits];
+  uint32_t checkedOk = 0;
+  uint32_t uncheckedOk = 0;
+  uint32_t packet;
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t sent = benchAirSwimmerPacket();
+    uint8_t noiseBits = benchRandom() % AirSwimmerIRProtocol::packetBits;
+    uint16_t *pulse = pulses;
+    
+    for (uint8_t bit = 0; bit < noiseBits; ++bit) {
+      pulse = benchPulse<AirSwimmerIRProtocol>(pulse, LOW, AirSwimmerIRProtocol::pulseGapDuration);
+      pulse = benchPulse<AirSwimmerIRProtocol>(pulse, HIGH, (benchRandom() & 1)
+        ? AirSwimmerIRProtocol::longPulseDuration : AirSwimmerIRProtocol::shortPulseDuration);
+    }
+    
+    uint8_t pulseCount = (pulse - pulses) + benchEncode<AirSwimmerIRProtocol>(&sent, pulse);
+    
+    for (uint8_t p = 0; p < pulseCount; ++p) {
+      if (checked.decode(pulses[p], &packet) && packet == sent) {
+        ++checkedOk;
+      }
+      if (unchecked.decode(pulses[p], &packet) && packet == sent) {
+        ++uncheckedOk;
+      }
+    }
+  }
+  
+  benchReport("noise_frames", (uint64_t)count);
+  benchReport("noise_checked_ok", (uint64_t)checkedOk);
+  benchReport("noise_unchecked_ok", (uint64_t)uncheckedOk);
+  
+  return count - checkedOk;
+}
+
+/**
+ * Overflows the RX pulse buffer, lets the main loop catch up, then checks
+ * that the saturated pulse marking the loss sits between the pulses kept
+ * before the overflow and those captured after it.
+ *
+ * @return Number of pulses out of place
+ */
+static uint32_t benchOverflow()
+{
+  IRPulseBuffer buffer;
+  uint32_t failures = 0;
+  uint16_t expected = 1;
+  uint16_t pulse;
+  
+  for (uint16_t i = 1; i <= IR_PULSE_BUFFER_SIZE + 10; ++i) {
+    buffer.push(i);
+  }
+  
+  for (uint8_t i = 0; i < 10; ++i) {
+    if (!buffer.pop(&pulse) || pulse != expected) {
+      ++failures;
+    }
+    ++expected;
+  }
+  
+  for (uint16_t i = 1000; i < 1005; ++i) {
+    buffer.push(i);
+  }
+  
+  while (buffer.pop(&pulse)) {
+    if (expected == IR_PULSE_BUFFER_SIZE) {
+      expected = IR_PULSE_WIDTH;
+    }
+    
+    failures += pulse != expected;
+    expected = expected == IR_PULSE_WIDTH ? 1000 : expected + 1;
+  }
+  
+  failures += expected != 1005;
+  
+  benchReport("overflow_misplaced", (uint64_t)failures);
+  
+  return failures;
+}
+
+/**
+ * Air Swimmer transmitter giving the bench access to tx()
+ */
+class BenchTx : public IRProtocol<AirSwimmerIRProtocol> {
+  public:
+    BenchTx() : IRProtocol<AirSwimmerIRProtocol>(0, 1) {}
+    
+    uint8_t send(uint32_t *packet) { return this->tx(packet); }
+};
+
+/**
+ * Queues the same packet twice while the first is waiting, then once more
+ * after the TX ISR has started it. Only the second is coalesced.
+ *
+ * @return Number of packets coalesced or queued wrongly
+ */
+static uint32_t benchCoalesce()
+{
+  BenchTx transmitter;
+  uint32_t packet = benchAirSwimmerPacket();
+  uint32_t startTime;
+  uint32_t failures = 0;
+  
+  IRHost::reset();
+  transmitter.begin();
+  
+  uint8_t queued = transmitter.getTxQueuedCount();
+  uint8_t started = transmitter.getTxStart(&startTime);
+  
+  transmitter.send(&packet);
+  transmitter.send(&packet);
+  failures += (uint8_t)(transmitter.getTxQueuedCount() - queued) != 1;
+  
+  while (transmitter.getTxStart(&startTime) == started) {
+    IRHost::advance(BENCH_LOOP_PERIOD);
+  }
+  
+  transmitter.send(&packet);
+  failures += (uint8_t)(transmitter.getTxQueuedCount() - queued) != 2;
+  
+  while (transmitter.isTransmitting()) {
+    IRHost::advance(BENCH_LOOP_PERIOD);
+  }
+  
+  failures += (uint8_t)(transmitter.getTxStart(&startTime) - started) != 2;
+  
+  benchReport("coalesce_errors", (uint64_t)failures);
+  
+  return failures;
+}
+
+/**
+ * Protocol with 112-bit packets, to exercise packets spanning several words
+ */
+struct BenchLongIRProtocol {
+  static const uint16_t startPulseDuration = 4500;
+  static const uint32_t gapDuration        = 20000;
+  static const uint32_t frameGapDuration   = 20000;
+  static const uint16_t pulseGapDuration   = 560;
+  static const uint16_t shortPulseDuration = 560;
+  static const uint16_t longPulseDuration  = 1690;
+  static const uint16_t pulseTolerance     = 200;
+  static const uint16_t trackingTolerance  = 150;
+  static const uint8_t  packetBits         = 112;
+  static const uint8_t  txFrequency        = 38;
+  static const uint8_t  pulseInType        = LOW;
+  static const uint8_t  signatureBits      = 0;
+  static const uint32_t signature          = 0;
+  static const uint8_t  hasChecksum        = 0;
+  
+  static uint8_t checksum(const uint32_t *) { return 0; }
+};
+
+#define BENCH_LONG_WORDS IR_PACKET_WORDS(BenchLongIRProtocol::packetBits)
+
+/**
+ * Transmitter of BenchLongIRProtocol packets
+ */
+class BenchLongIR : public IRProtocol<BenchLongIRProtocol> {
+  public:
+    BenchLongIR() : IRProtocol<BenchLongIRProtocol>(0, 1) {}
+    
+    uint8_t send(uint32_t *packet) { return this->tx(packet); }
+};
+
+/**
+ * Random BenchLongIRProtocol packet
+ */
+static void benchLongPacket(uint32_t *packet)
+{
+  for (uint8_t i = 0; i < BENCH_LONG_WORDS; ++i) {
+    packet[i] = benchRandom();
+  }
+  
+  packet[BENCH_LONG_WORDS - 1] &= (1UL << (BenchLongIRProtocol::packetBits % 32)) - 1;
+}
+
+static uint8_t benchSamePacket(const uint32_t *a, const uint32_t *b)
+{
+  for (uint8_t i = 0; i < BENCH_LONG_WORDS; ++i) {
+    if (a[i] != b[i]) {
+      return 0;
+    }
+  }
+  
+  return 1;
+}
+
+// Decoder of the carrier during the long packet TX run
+static IRProtocolDecoder<BenchLongIRProtocol> *benchLongDecoder;
+static uint32_t benchLongReceived[BENCH_LONG_WORDS];
+static uint8_t benchLongComplete;
+static uint64_t benchLongEdge;
+
+static void benchOnLongCarrier(uint8_t level, uint64_t time)
+{
+  uint64_t us = (time - benchLongEdge) / 1000;
+  uint16_t pulse = (level ? IR_PULSE_LEVEL : 0) | (uint16_t)(us > IR_PULSE_WIDTH ? IR_PULSE_WIDTH : us);
+  
+  benchLongEdge = time;
+  
+  if (benchLongDecoder->decode(pulse, benchLongReceived)) {
+    benchLongComplete = 1;
+  }
+}
+
+/**
+ * Decodes 112-bit packets, then sends some through the TX ISR and decodes
+ * them from the carrier.
+ *
+ * @return Number of packets lost
+ */
+static uint32_t benchLong(uint32_t count)
+{
+  IRProtocolDecoder<BenchLongIRProtocol> decoder;
+  uint16_t pulses[BENCH_PULSES(BenchLongIRProtocol::packetBits)];
+  uint32_t sent[BENCH_LONG_WORDS];
+  uint32_t packet[BENCH_LONG_WORDS];
+  uint64_t elapsed = 0;
+  uint32_t decoded = 0;
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    benchLongPacket(sent);
+    uint8_t pulseCount = benchEncode<BenchLongIRProtocol>(sent, pulses);
+    uint64_t start = benchClock();
+    
+    for (uint8_t p = 0; p < pulseCount; ++p) {
+      if (decoder.decode(pulses[p], packet) && benchSamePacket(packet, sent)) {
+        ++decoded;
+      }
+    }
+    
+    elapsed += benchClock() - start;
+  }
+  
+  IRProtocolDecoder<BenchLongIRProtocol> txDecoder;
+  BenchLongIR transmitter;
+  uint32_t txCount = count / 100;
+  uint32_t txDecoded = 0;
+  
+  IRHost::reset();
+  IRHost::setCarrierListener(benchOnLongCarrier);
+  benchLongDecoder = &txDecoder;
+  benchLongEdge = 0;
+  transmitter.begin();
+  
+  for (uint32_t i = 0; i < txCount; ++i) {
+    benchLongPacket(sent);
+    benchLongComplete = 0;
+    transmitter.send(sent);
+    
+    while (transmitter.isTransmitting()) {
+      IRHost::advance(BENCH_LOOP_PERIOD);
+    }
+    
+    if (benchLongComplete && benchSamePacket(benchLongReceived, sent)) {
+      ++txDecoded;
+    }
+  }
+  
+  IRHost::setCarrierListener(0);
+  
+  benchReport("long_decode_frames", (uint64_t)count);
+  benchReport("long_decode_ok", (uint64_t)decoded);
+  benchReport("long_decode_ns_per_frame", (double)elapsed / count);
+  benchReport("long_tx_frames", (uint64_t)txCount);
+  benchReport("long_tx_ok", (uint64_t)txDecoded);
+  
+  return (count - decoded) + (txCount - txDecoded);
+}
+
+/**
+ * Air Swimmer timings accepting any signature, to tell the fleet's vehicles
+ * apart on the carrier
+ */
+struct BenchFleetIRProtocol : AirSwimmerIRProtocol {
+  static const uint8_t signatureBits = 0;
+  static const uint8_t hasChecksum   = 0;
+};
+
+/**
+ * Virtual time each fleet is flown for, in nanoseconds
+ */
+#define BENCH_FLEET_TIME 20000000000ULL
+
+// Observation of the carrier during the fleet runs
+static IRProtocolDecoder<BenchFleetIRProtocol> *benchFleetDecoder;
+static AirSwimmerFleet *benchFleetSender;
+static uint32_t benchFleetEchoMisses;
+static uint64_t benchFleetEdge;
+static uint64_t benchFleetLast[AIRSWIMMER_FLEET_SIZE];
+static uint64_t benchFleetMaxInterval;
+static uint64_t benchFleetBusy;
+static uint32_t benchFleetFrames;
+
+static void benchOnFleetCarrier(uint8_t level, uint64_t time)
+{
+  uint64_t us = (time - benchFleetEdge) / 1000;
+  uint16_t pulse = (level ? IR_PULSE_LEVEL : 0) | (uint16_t)(us > IR_PULSE_WIDTH ? IR_PULSE_WIDTH : us);
+  uint32_t packet;
+  
+  benchFleetEdge = time;
+  
+  if (!benchFleetDecoder->decode(pulse, &packet)) {
+    return;
+  }
+  
+  uint16_t vehicle = (uint16_t)(packet >> 8) - AIRSWIMMER_IR_SIGNATURE;
+  
+  if (vehicle >= AIRSWIMMER_FLEET_SIZE) {
+    return;
+  }
+  
+  if (benchFleetLast[vehicle] && time - benchFleetLast[vehicle] > benchFleetMaxInterval) {
+    benchFleetMaxInterval = time - benchFleetLast[vehicle];
+  }
+  
+  if (!benchFleetSender->isEcho(&packet)) {
+    ++benchFleetEchoMisses;
+  }
+  
+  benchFleetLast[vehicle] = time;
+  benchFleetBusy += AirSwimmerFleet::getPacketDuration(&packet)
+    + AirSwimmerIRProtocol::pulseGapDuration + AirSwimmerIRProtocol::frameGapDuration;
+  ++benchFleetFrames;
+}
+
+/**
+ * Flies fleets of one up to AIRSWIMMER_FLEET_SIZE vehicles, each with its
+ * own signature, and decodes their frames from the carrier.
+ *
+ * The clock moves while the fleet runs (see IRHost::setCpuCost()), as
+ * it would on the board.
+ *
+ * @return Number of frames lost, plus the number of frames started late
+ *         by fleets within the channel capacity, plus one per such fleet
+ *         leaving a vehicle without frames for over the slack past its gap,
+ *         plus the number of frames the fleet did not recognize as its own
+ */
+static uint32_t benchFleet()
+{
+  IRProtocolDecoder<BenchFleetIRProtocol> decoder;
+  uint32_t failures = 0;
+  char name[64];
+  
+  IRHost::setCarrierListener(benchOnFleetCarrier);
+  benchFleetDecoder = &decoder;
+  
+  for (uint8_t size = 1; size <= AIRSWIMMER_FLEET_SIZE; ++size) {
+    AirSwimmerVehicle vehicles[AIRSWIMMER_FLEET_SIZE];
+    AirSwimmerFleet fleet;
+    AirSwimmerFleetStats stats;
+    
+    IRHost::reset();
+    IRHost::setCpuCost(BENCH_READ_COST, BENCH_INTERRUPT_COST);
+    benchFleetEdge = 0;
+    benchFleetMaxInterval = 0;
+    benchFleetBusy = 0;
+    benchFleetFrames = 0;
+    benchFleetSender = &fleet;
+    benchFleetEchoMisses = 0;
+    
+    for (uint8_t i = 0; i < size; ++i) {
+      benchFleetLast[i] = 0;
+      vehicles[i].setSignature(AIRSWIMMER_IR_SIGNATURE + i);
+      fleet.add(&vehicles[i]);
+    }
+    
+    fleet.begin();
+    
+    while (IRHost::now() < BENCH_FLEET_TIME) {
+      // Keep every vehicle flying straight at full speed
+      for (uint8_t i = 0; i < size; ++i) {
+        vehicles[i].setSpeed(100);
+        vehicles[i].prepareFlap(0);
+      }
+      
+      fleet.update();
+      IRHost::advance(BENCH_LOOP_PERIOD);
+    }
+    
+    while (fleet.isTransmitting()) {
+      IRHost::advance(BENCH_LOOP_PERIOD);
+    }
+    
+    fleet.getStats(&stats);
+    
+    if (benchFleetFrames != stats.frames || (!fleet.isOverloaded() && stats.lateFrames)) {
+      failures += stats.frames - benchFleetFrames + stats.lateFrames;
+    }
+    
+    failures += benchFleetEchoMisses;
+    
+    if (!fleet.isOverloaded() && (!benchFleetFrames || benchFleetMaxInterval
+        > 1000ULL * (AirSwimmerIRProtocol::gapDuration + AIRSWIMMER_FLEET_SLACK_US))) {
+      ++failures;
+    }
+    
+    snprintf(name, sizeof(name), "fleet_%u_load_permille", size);
+    benchReport(name, (uint64_t)stats.load);
+    snprintf(name, sizeof(name), "fleet_%u_busy_permille", size);
+    benchReport(name, benchFleetBusy * 1000000 / IRHost::now());
+    snprintf(name, sizeof(name), "fleet_%u_frames", size);
+    benchReport(name, (uint64_t)stats.frames);
+    snprintf(name, sizeof(name), "fleet_%u_rx_frames", size);
+    benchReport(name, (uint64_t)benchFleetFrames);
+    snprintf(name, sizeof(name), "fleet_%u_late_frames", size);
+    benchReport(name, (uint64_t)stats.lateFrames);
+    snprintf(name, sizeof(name), "fleet_%u_max_late_ms", size);
+    benchReport(name, (uint64_t)stats.maxLateMs);
+    snprintf(name, sizeof(name), "fleet_%u_max_interval_ms", size);
+    benchReport(name, benchFleetMaxInterval / 1000000);
+    snprintf(name, sizeof(name), "fleet_%u_echo_misses", size);
+    benchReport(name, (uint64_t)benchFleetEchoMisses);
+  }
+  
+  IRHost::setCarrierListener(0);
+  
+  return failures;
+}
+
+/**
+ * Observation of the TX carrier during the sketch simulation
+ */
+struct BenchCarrier {
+  uint64_t lastEdge;
+  uint32_t edges;
+  uint64_t errorTotal;
+  uint64_t errorMax;
+  uint32_t frames;
+  uint32_t validFrames;
+  uint32_t vehicleFrames[VEHICLE_COUNT];
+  IRProtocolDecoder<BenchFleetIRProtocol> decoder;
+};
+
+static BenchCarrier carrier;
+
+/**
+ * Width error of a TX interval against the nearest nominal Air Swimmer
+ * width, in nanoseconds
+ */
+static uint64_t benchTxError(uint64_t width)
+{
+  static const uint64_t nominal[] = {
+    AirSwimmerIRProtocol::pulseGapDuration * 1000ULL,
+    AirSwimmerIRProtocol::shortPulseDuration * 1000ULL,
+    AirSwimmerIRProtocol::longPulseDuration * 1000ULL
+  };
+  uint64_t best = ~0ULL;
+  
+  for (uint8_t i = 0; i < sizeof(nominal) / sizeof(nominal[0]); ++i) {
+    uint64_t error = width > nominal[i] ? width - nominal[i] : nominal[i] - width;
+    
+    if (error < best) {
+      best = error;
+    }
+  }
+  
+  return best;
+}
+
+/**
+ * Carrier listener. The interval that just ended is timed against the
+ * protocol, then decoded as the receiver would see it: LOW while the
+ * carrier is on.
+ */
+static void benchOnCarrier(uint8_t level, uint64_t time)
+{
+  uint64_t width = time - carrier.lastEdge;
+  uint8_t carrierWasOn = !level;
+  uint32_t packet;
+  
+  carrier.lastEdge = time;
+  
+  // Intervals longer than any data pulse separate frames
+  if (width < 2000ULL * AirSwimmerIRProtocol::longPulseDuration) {
+    uint64_t error = benchTxError(width);
+    
+    ++carrier.edges;
+    carrier.errorTotal += error;
+    
+    if (error > carrier.errorMax) {
+      carrier.errorMax = error;
+    }
+  } else if (carrierWasOn) {
+    return;
+  } else {
+    ++carrier.frames;
+  }
+  
+  uint64_t us = width / 1000;
+  uint16_t pulse = (carrierWasOn ? 0 : IR_PULSE_LEVEL) | (uint16_t)(us > IR_PULSE_WIDTH ? IR_PULSE_WIDTH : us);
+  
+  if (carrier.decoder.decode(pulse, &packet)) {
+    uint16_t vehicle = (uint16_t)(packet >> 8) - AIRSWIMMER_IR_SIGNATURE;
+    
+    if (vehicle < VEHICLE_COUNT) {
+      ++carrier.validFrames;
+      ++carrier.vehicleFrames[vehicle];
+    }
+  }
+}
+
+/**
+ * Frames sent to the Air Swimmer of a Gyropter channel (none if the
+ * channel is not flown)
+ */
+static uint64_t benchChannelFrames(uint8_t channel)
+{
+  uint8_t vehicle = channelVehicles[channel];
+  
+  return vehicle < VEHICLE_COUNT ? carrier.vehicleFrames[vehicle] : 0;
+}
+
+/**
+ * Plays a frame's pulses into the RX pin, starting at the given time.
+ *
+ * @return Time at which the last pulse ends
+ */
+static uint64_t benchPlay(const uint16_t *pulses, uint8_t count, uint64_t time)
+{
+  for (uint8_t p = 0; p < count; ++p) {
+    IRHost::scheduleEdge(time, rxPin, (pulses[p] & IR_PULSE_LEVEL) ? HIGH : LOW);
+    time += (uint64_t)(pulses[p] & IR_PULSE_WIDTH) * 1000;
+  }
+  
+  IRHost::scheduleEdge(time, rxPin, HIGH);
+  return time;
+}
+
+/**
+ * Receives Gyropter frames whose start pulse is lost through the RX pin,
+ * leaving the line idle after each frame's last pulse: the gap that ends
+ * the frame is only seen once the RX timeout stores it.
+ *
+ * @return Number of frames lost or decoded later than the timeout allows
+ */
+static uint32_t benchGapTimeout(uint32_t count)
+{
+  IRProtocol<GyropterIRProtocol> receiver(rxPin, 0);
+  uint16_t pulses[BENCH_MAX_PULSES];
+  uint64_t maxDelay = 0;
+  uint32_t decoded = 0;
+  uint32_t late = 0;
+  uint32_t packet;
+  
+  IRHost::reset();
+  receiver.begin();
+  
+  // The receiver only frames a packet by gaps once it has seen one
+  IRHost::advance(2000ULL * IR_PULSE_WIDTH);
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t sent = benchGyropterPacket();
+    uint8_t pulseCount = benchEncode<GyropterIRProtocol>(&sent, pulses);
+    
+    // Neither the gap and start pulse before the bits nor the trailing gap
+    uint64_t frameEnd = benchPlay(pulses + 2, pulseCount - 3, IRHost::now());
+    uint64_t deadline = frameEnd + 2000ULL * IR_PULSE_WIDTH;
+    uint8_t received = 0;
+    
+    while (!received && IRHost::now() < deadline) {
+      IRHost::advance(BENCH_LOOP_PERIOD);
+      received = receiver.poll(&packet);
+    }
+    
+    if (received && packet == sent) {
+      uint64_t delay = IRHost::now() - frameEnd;
+      
+      ++decoded;
+      
+      if (delay > maxDelay) {
+        maxDelay = delay;
+      }
+      
+      if (delay > 1000ULL * IR_PULSE_WIDTH + BENCH_LOOP_PERIOD) {
+        ++late;
+      }
+    }
+  }
+  
+  benchReport("gap_timeout_frames", (uint64_t)count);
+  benchReport("gap_timeout_ok", (uint64_t)decoded);
+  benchReport("gap_timeout_max_delay_us", maxDelay / 1000);
+  
+  return (count - decoded) + late;
+}
+
+/**
+ * Idles through the given virtual time, awake for a set share of each
+ * millis() tick and asleep in IRPower the rest of it, well past the 71.6
+ * minutes after which a microsecond count wraps.
+ *
+ * @return 1 if the duty cycle or elapsed time drifts from the actual ones
+ */
+static uint32_t benchPower(uint32_t minutes)
+{
+  IRPower power;
+  IRPowerStats stats;
+  uint64_t end = minutes * 60000000000ULL;
+  uint64_t asleep = 0;
+  
+  IRHost::reset();
+  power.begin();
+  
+  while (IRHost::now() < end) {
+    uint64_t start;
+    
+    IRHost::advance(BENCH_POWER_AWAKE);
+    start = IRHost::now();
+    power.sleep();
+    asleep += IRHost::now() - start;
+  }
+  
+  uint64_t awake = 1000 - asleep * 1000 / IRHost::now();
+  uint64_t dutyCycle = power.getDutyCycle();
+  
+  power.getStats(&stats);
+  
+  benchReport("power_minutes", (uint64_t)minutes);
+  benchReport("power_awake_permille", dutyCycle);
+  benchReport("power_actual_awake_permille", awake);
+  benchReport("power_elapsed_ms", (uint64_t)stats.elapsedMs);
+  
+  return dutyCycle + 1 < awake || dutyCycle > awake + 1
+    || stats.elapsedMs != IRHost::now() / 1000000;
+}
+
+/**
+ * Reports the median of a latency histogram, as the upper bound of the
+ * bucket holding it
+ */
+static void benchLatency(const char *name, uint8_t histogram)
+{
+  uint32_t total = 0;
+  uint32_t seen = 0;
+  
+  for (uint8_t bucket = 0; bucket < IR_LATENCY_BUCKETS; ++bucket) {
+    total += latency.getCount(histogram, bucket);
+  }
+  
+  for (uint8_t bucket = 0; bucket < IR_LATENCY_BUCKETS; ++bucket) {
+    seen += latency.getCount(histogram, bucket);
+    
+    if (total && 2 * seen >= total) {
+      printf("sketch_latency_%s_p50_us %lu\n", name, 1UL << (bucket + IR_LATENCY_SHIFT));
+      return;
+    }
+  }
+  
+  printf("sketch_latency_%s_p50_us 0\n", name);
+}
+
+/**
+ * Reports the counters of one of the sketch's tasks
+ */
+static void benchTask(const char *name, uint8_t task)
+{
+  CoopTaskStats stats;
+  
+  scheduler.getStats(task, &stats);
+  printf("sketch_task_%s_runs %lu\n", name, (unsigned long)stats.runs);
+  printf("sketch_task_%s_max_late_us %u\n", name, stats.maxLateUs);
+}
+
+/**
+ * End-to-end run of the sketch on the simulated board
+ *
+ * @return Number of Gyropter frames lost, Air Swimmer frames sent but not
+ *         decoded, and TX edges late or off their nominal width
+ */
+static uint32_t benchSketch(uint32_t count)
+{
+  uint16_t pulses[BENCH_MAX_PULSES];
+  uint32_t decoded = 0;
+  uint64_t loops = 0;
+  
+  IRHost::reset();
+  IRHost::setCarrierListener(benchOnCarrier);
+  IRHost::setCpuCost(BENCH_READ_COST, BENCH_INTERRUPT_COST);
+  setup();
+  
+  uint64_t start = benchClock();
+  
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t packet = benchGyropterPacket();
+    uint8_t pulseCount = benchEncode<GyropterIRProtocol>(&packet, pulses);
+    uint64_t frameEnd = benchPlay(pulses, pulseCount, IRHost::now());
+    
+    // The RX task decodes the frame within one period of its end
+    while (IRHost::now() < frameEnd + RX_TASK_PERIOD * 1000ULL) {
+      uint64_t passStart = IRHost::now();
+      
+      loop();
+      ++loops;
+      
+      if (IRHost::now() == passStart) {
+        IRHost::advance(BENCH_TASK_COST);
+      }
+    }
+    
+    if (inputPacketBuffer == packet) {
+      ++decoded;
+    }
+  }
+  
+  // Lets the frames already queued go out, so every frame seen on the
+  // carrier is complete
+  while (airswimmers.isTransmitting()) {
+    IRHost::advance(BENCH_TASK_COST);
+  }
+  
+  uint64_t elapsed = benchClock() - start;
+  
+  benchReport("sketch_frames", (uint64_t)count);
+  benchReport("sketch_decoded", (uint64_t)decoded);
+  benchReport("sketch_loops", loops);
+  benchReport("sketch_virtual_ms", IRHost::now() / 1000000);
+  benchReport("sketch_wall_ms", (double)elapsed / 1000000);
+  benchReport("sketch_rx_interrupts", (uint64_t)IRHost::rxInterrupts());
+  benchReport("sketch_tx_interrupts", (uint64_t)IRHost::txInterrupts());
+  benchReport("sketch_tx_frames", (uint64_t)carrier.frames);
+  benchReport("sketch_tx_valid", (uint64_t)carrier.validFrames);
+  benchReport("sketch_tx_channel_a_frames", benchChannelFrames(GYROPTER_IR_CHANNEL_A));
+  benchReport("sketch_tx_channel_b_frames", benchChannelFrames(GYROPTER_IR_CHANNEL_B));
+  benchReport("sketch_tx_channel_c_frames", benchChannelFrames(GYROPTER_IR_CHANNEL_C));
+  benchReport("sketch_tx_edges", (uint64_t)carrier.edges);
+  benchReport("sketch_tx_error_max_ns", carrier.errorMax);
+  benchReport("sketch_tx_error_mean_ns", carrier.edges ? (double)carrier.errorTotal / carrier.edges : 0.0);
+  
+  IRTxStats txStats;
+  airswimmers.getTxStats(&txStats);
+  
+  benchReport("sketch_tx_isr_interrupts", (uint64_t)txStats.interrupts);
+  benchReport("sketch_tx_isr_max_cycles", (uint64_t)txStats.maxCycles);
+  benchReport("sketch_tx_late_edges", (uint64_t)txStats.lateEdges);
+  benchReport("sketch_tx_max_late_ticks", (uint64_t)txStats.maxLateTicks);
+  benchReport("sketch_tx_dropped_frames", (uint64_t)txStats.droppedFrames);
+  
+  benchLatency("total", 0);
+  benchLatency("frame", IR_LATENCY_FRAME_END);
+  benchLatency("decode", IR_LATENCY_DECODED);
+  benchLatency("apply", IR_LATENCY_APPLIED);
+  benchLatency("queue", IR_LATENCY_QUEUED);
+  benchLatency("emit", IR_LATENCY_EMITTED);
+  benchReport("sketch_latency_dropped", (uint64_t)latency.getDropped());
+  
+  benchTask("rx", rxTaskId);
+  benchTask("map", mapTaskId);
+  benchTask("tx", txTaskId);
+  benchTask("serial", serialTaskId);
+  benchTask("telemetry", telemetryTaskId);
+  
+  IRPowerStats powerStats;
+  power.getStats(&powerStats);
+  
+  benchReport("sketch_power_sleeps", (uint64_t)powerStats.sleeps);
+  benchReport("sketch_power_rx_wakes", (uint64_t)powerStats.rxWakes);
+  benchReport("sketch_power_tx_wakes", (uint64_t)powerStats.txWakes);
+  benchReport("sketch_power_timer_wakes", (uint64_t)powerStats.timerWakes);
+  benchReport("sketch_power_awake_permille", (uint64_t)power.getDutyCycle());
+  benchReport("sketch_power_carrier_permille", IRHost::carrierRunTime() * 1000 / IRHost::now());
+  
+  return (count - decoded) + (carrier.frames - carrier.validFrames)
+    + (carrier.errorMax > BENCH_TX_TOLERANCE) + txStats.lateEdges;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t decodeFrames = argc > 1 ? strtoul(argv[1], 0, 0) : 1000000;
+  uint32_t sketchFrames = argc > 2 ? strtoul(argv[2], 0, 0) : 2000;
+  uint32_t failures = 0;
+  
+  failures += benchDecode(decodeFrames);
+  failures += benchMultiDecode(decodeFrames);
+  failures += benchDrift(decodeFrames / 10, 60);
+  failures += benchSync(decodeFrames / 10);
+  failures += benchNoise(decodeFrames / 10);
+  failures += benchOverflow();
+  failures += benchCoalesce();
+  failures += benchLong(decodeFrames / 10);
+  failures += benchFleet();
+  failures += benchGapTimeout(decodeFrames / 1000);
+  failures += benchPower(120);
+  failures += benchSketch(sketchFrames);
+  
+  return failures ? 1 : 0;
+}
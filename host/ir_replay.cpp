@@ -0,0 +1,160 @@
+/**
+ * IR Replay
+ *
+ * Host reader for pulse captures recorded by the augmented_air_swimmer
+ * sketch (see IRCapture.h). Each capture file is memory-mapped and its
+ * pulses are fed to the same decoders the sketch runs, as fast as they
+ * can be decoded.
+ *
+ * Results are printed as one "name value" pair per line; with -v every
+ * decoded frame is listed first, as "frame <protocol> <packet>". The exit
+ * status is non-zero when a file cannot be read or is not a capture.
+ *
+ * Usage: ir_replay [-v] capture...
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include <IR.h>
+#include <IRCapture.h>
+#include <IRMultiDecoder.h>
+#include <GyropterIR.h>
+#include <AirSwimmerIR.h>
+#include "CaptureFile.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * Totals over every replayed capture
+ */
+struct ReplayStats {
+  uint64_t bytes;
+  uint64_t pulses;
+  uint64_t frames[AIRSWIMMER_IR_PROTOCOL + 1];
+  uint64_t truncated;
+  uint64_t elapsed;
+};
+
+static uint64_t replayClock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Counts, and optionally prints, one decoded frame
+ */
+static void replayFrame(const IRFrame *frame, uint8_t verbose, ReplayStats *stats)
+{
+  if (frame->protocol <= AIRSWIMMER_IR_PROTOCOL) {
+    ++stats->frames[frame->protocol];
+  }
+  
+  if (verbose) {
+    printf("frame %u 0x%06lx\n", frame->protocol, (unsigned long)frame->packet);
+  }
+}
+
+/**
+ * Ends the recording. The last packet is only framed by the idle gap that
+ * follows it, which no capture contains: a saturated gap is fed instead,
+ * until no frame is left pending in the decoders.
+ */
+static void replayFlush(IRMultiDecoder *decoder, uint8_t verbose, ReplayStats *stats)
+{
+  IRFrame frame;
+  
+  while (decoder->decode(IR_PULSE_LEVEL | IR_PULSE_WIDTH, &frame)) {
+    replayFrame(&frame, verbose, stats);
+  }
+}
+
+/**
+ * Replays one capture through the decoders. Decoder state carries over
+ * from the previous capture, as if the files were one recording.
+ *
+ * @return Boolean indicating whether the file is a valid capture
+ */
+static uint8_t replayFile(const char *path, IRMultiDecoder *decoder, uint8_t verbose, ReplayStats *stats)
+{
+  CaptureFile capture;
+  
+  if (!capture.open(path)) {
+    fprintf(stderr, "%s: %s\n", path, capture.getError());
+    return 0;
+  }
+  
+  const uint8_t *p = capture.begin();
+  const uint8_t *end = capture.end();
+  uint16_t pulse;
+  IRFrame frame;
+  
+  uint64_t start = replayClock();
+  
+  while (IRCapture::decode(&p, end, &pulse)) {
+    ++stats->pulses;
+    
+    if (decoder->decode(pulse, &frame)) {
+      replayFrame(&frame, verbose, stats);
+    }
+  }
+  
+  stats->elapsed += replayClock() - start;
+  stats->bytes += capture.getSize();
+  stats->truncated += end - p;
+  
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  IRProtocolDecoder<GyropterIRProtocol> gyropterDecoder;
+  IRProtocolDecoder<AirSwimmerIRProtocol> airSwimmerDecoder;
+  IRMultiDecoder decoder;
+  ReplayStats stats;
+  uint8_t verbose = 0;
+  int files = 0;
+  int failures = 0;
+  
+  memset(&stats, 0, sizeof(stats));
+  decoder.add(&gyropterDecoder, GYROPTER_IR_PROTOCOL);
+  decoder.add(&airSwimmerDecoder, AIRSWIMMER_IR_PROTOCOL);
+  
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-v") == 0) {
+      verbose = 1;
+      continue;
+    }
+    
+    ++files;
+    
+    if (!replayFile(argv[i], &decoder, verbose, &stats)) {
+      ++failures;
+    }
+  }
+  
+  replayFlush(&decoder, verbose, &stats);
+  
+  if (files == 0) {
+    fprintf(stderr, "usage: %s [-v] capture...\n", argv[0]);
+    return 2;
+  }
+  
+  printf("replay_files %d\n", files);
+  printf("replay_bytes %llu\n", (unsigned long long)stats.bytes);
+  printf("replay_pulses %llu\n", (unsigned long long)stats.pulses);
+  printf("replay_gyropter_frames %llu\n", (unsigned long long)stats.frames[GYROPTER_IR_PROTOCOL]);
+  printf("replay_airswimmer_frames %llu\n", (unsigned long long)stats.frames[AIRSWIMMER_IR_PROTOCOL]);
+  printf("replay_truncated_bytes %llu\n", (unsigned long long)stats.truncated);
+  printf("replay_ns_per_pulse %.3f\n", stats.pulses ? (double)stats.elapsed / stats.pulses : 0.0);
+  
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * Air Swimmer Fleet
+ *
+ * This library drives several Air Swimmers, each paired with its own
+ * signature, from a single IR emitter.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "AirSwimmerFleet.h"
+
+/**
+ * Construct an empty fleet. IR Out is enabled by begin().
+ */
+AirSwimmerFleet::AirSwimmerFleet()
+: IRProtocol<AirSwimmerIRProtocol>(0, 1),
+  vehicleCount(0),
+  sentPackets(),
+  sentIndex(0),
+  channelFreeTime(0),
+  stats()
+{
+}
+
+/**
+ * Adds a vehicle to the fleet. Its first frame is due right away.
+ *
+ * @param vehicle Vehicle to drive. Its settings are still changed through
+ *                the vehicle itself.
+ * @return Boolean indicating whether the vehicle was added
+ */
+uint8_t AirSwimmerFleet::add(AirSwimmerVehicle *vehicle)
+{
+  if (this->vehicleCount == AIRSWIMMER_FLEET_SIZE) {
+    return 0;
+  }
+  
+  this->vehicles[this->vehicleCount] = vehicle;
+  this->dueTimes[this->vehicleCount] = micros();
+  this->airtimes[this->vehicleCount] = 0;
+  this->txCounts[this->vehicleCount] = this->getTxQueuedCount();
+  ++this->vehicleCount;
+  
+  return 1;
+}
+
+/**
+ * Must be called from the main loop. While the TX queue has room, queues
+ * the frame of the vehicle due first, among those due by the time the
+ * frames already queued are sent. Each vehicle is served at most once per
+ * call.
+ */
+void AirSwimmerFleet::update()
+{
+  uint32_t now = micros();
+  uint8_t served = 0;
+  
+  if ((int32_t)(now - this->channelFreeTime) > 0) {
+    this->channelFreeTime = now;
+  }
+  
+  while (!this->isTxQueueFull()) {
+    uint8_t next = AIRSWIMMER_FLEET_SIZE;
+    
+    for (uint8_t i = 0; i < this->vehicleCount; ++i) {
+      if ((served & _BV(i)) || (int32_t)(this->dueTimes[i] - this->channelFreeTime) > 0) {
+        continue;
+      }
+      
+      if (next == AIRSWIMMER_FLEET_SIZE || (int32_t)(this->dueTimes[i] - this->dueTimes[next]) < 0) {
+        next = i;
+      }
+    }
+    
+    if (next == AIRSWIMMER_FLEET_SIZE) {
+      break;
+    }
+    
+    served |= _BV(next);
+    this->sendFrame(next, now);
+  }
+}
+
+/**
+ * Queues a vehicle's next frame, to start once the channel is free, and
+ * works out when its following frame is due.
+ *
+ * @param index Index of the vehicle
+ * @param now Time update() was called at, in microseconds. The frame starts
+ *            no earlier.
+ */
+void AirSwimmerFleet::sendFrame(uint8_t index, uint32_t now)
+{
+  AirSwimmerVehicle *vehicle = this->vehicles[index];
+  uint32_t start = this->channelFreeTime;
+  uint32_t late = start - this->dueTimes[index];
+  
+  // The commands are worked out for the time the frame will be on the air,
+  // rather than the time it is queued. The clock has moved on since 'now',
+  // so the offset is signed.
+  int32_t offset = (int32_t)(start - now);
+  uint32_t startMillis = millis() + (offset > 0 ? offset / 1000 : 0);
+  uint8_t commands = vehicle->nextCommands(startMillis);
+  uint32_t flapWait = vehicle->getFlapWait(startMillis);
+  
+  this->dueTimes[index] = start + AirSwimmerIRProtocol::gapDuration;
+  
+  if (flapWait < AirSwimmerIRProtocol::gapDuration / 1000) {
+    this->dueTimes[index] = start + flapWait * 1000;
+  }
+  
+  // A vehicle at rest needs no airtime
+  if (commands == 0) {
+    this->airtimes[index] = 0;
+    return;
+  }
+  
+  uint32_t packet = vehicle->getPacket(commands);
+  uint8_t queuedCount = this->getTxQueuedCount();
+  
+  // Pairing frames jump the queue, as they do for a lone AirSwimmerIR,
+  // unless another vehicle's pairing frame holds the priority slot. A
+  // packet still waiting to be sent is coalesced: it keeps the airtime
+  // counted when it was queued.
+  uint8_t priority = vehicle->isSyncing() && !this->isTxQueueFull(1);
+  
+  if (!this->tx(&packet, priority) || this->getTxQueuedCount() == queuedCount) {
+    return;
+  }
+  
+  uint16_t airtime = getPacketDuration(&packet) + AirSwimmerIRProtocol::pulseGapDuration
+    + AirSwimmerIRProtocol::frameGapDuration;
+  
+  this->airtimes[index] = airtime;
+  this->txCounts[index] = this->getTxQueuedCount();
+  this->sentPackets[this->sentIndex] = packet;
+  this->sentIndex = (this->sentIndex + 1) % AIRSWIMMER_FLEET_ECHO_PACKETS;
+  this->channelFreeTime = start + airtime;
+  ++this->stats.frames;
+  
+  if (late > AIRSWIMMER_FLEET_SLACK_US && this->stats.lateFrames != 0xFFFF) {
+    ++this->stats.lateFrames;
+  }
+  
+  if (late / 1000 > this->stats.maxLateMs) {
+    this->stats.maxLateMs = late / 1000 > 0xFFFF ? 0xFFFF : late / 1000;
+  }
+}
+
+/**
+ * Airtime needed to send every vehicle its last frame once per gap
+ * duration, in permille of the channel
+ */
+uint16_t AirSwimmerFleet::getLoad()
+{
+  uint32_t airtime = 0;
+  
+  for (uint8_t i = 0; i < this->vehicleCount; ++i) {
+    airtime += this->airtimes[i];
+  }
+  
+  return airtime * 1000 / AirSwimmerIRProtocol::gapDuration;
+}
+
+/**
+ * Indicates whether the fleet needs more airtime than the channel has, so
+ * its vehicles get their frames less often than once per gap duration.
+ */
+uint8_t AirSwimmerFleet::isOverloaded()
+{
+  return this->getLoad() > 1000;
+}
+
+/**
+ * Indicates whether a received packet is one the fleet sent, heard back by
+ * the receiver. The fleet's packets are told apart by their contents, as
+ * channel A's vehicle shares the default signature with the original
+ * remote, which may be in use while the fleet transmits.
+ *
+ * @param packet Packet received
+ * @return Boolean indicating whether the packet is one of the last
+ *         AIRSWIMMER_FLEET_ECHO_PACKETS queued
+ */
+uint8_t AirSwimmerFleet::isEcho(const uint32_t *packet)
+{
+  for (uint8_t i = 0; i < AIRSWIMMER_FLEET_ECHO_PACKETS; ++i) {
+    if (this->sentPackets[i] == *packet) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+/**
+ * Identifies the last packet queued for a vehicle, which can be matched
+ * with IR::getTxStart() to tell when it went out.
+ *
+ * @param index Index of the vehicle, in the order it was added
+ * @return Value of IR::getTxQueuedCount() once the packet was queued
+ */
+uint8_t AirSwimmerFleet::getVehicleTxCount(uint8_t index)
+{
+  return this->txCounts[index];
+}
+
+/**
+ * Copies the scheduler counters.
+ *
+ * @param stats Variable that will store the counters
+ */
+void AirSwimmerFleet::getStats(AirSwimmerFleetStats *stats)
+{
+  *stats = this->stats;
+  stats->load = this->getLoad();
+}
+
+/**
+ * Clears the scheduler counters.
+ */
+void AirSwimmerFleet::resetStats()
+{
+  this->stats = AirSwimmerFleetStats();
+}
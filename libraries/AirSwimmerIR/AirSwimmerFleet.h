@@ -0,0 +1,95 @@
+/**
+ * Air Swimmer Fleet
+ *
+ * This library drives several Air Swimmers, each paired with its own
+ * signature, from a single IR emitter.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#ifndef AIR_SWIMMER_FLEET_H_
+#define AIR_SWIMMER_FLEET_H_
+
+#include "AirSwimmerIR.h"
+
+/**
+ * Maximum number of vehicles in a fleet. Cannot exceed 8.
+ */
+#ifndef AIRSWIMMER_FLEET_SIZE
+#define AIRSWIMMER_FLEET_SIZE 4
+#endif
+
+/**
+ * A frame starting more than this many microseconds after it was due is
+ * counted as late. Defaults to the gap duration: a lone AirSwimmerIR only
+ * checks its flap timing once per gap, so a frame within the slack is no
+ * later than it would be without the fleet.
+ */
+#ifndef AIRSWIMMER_FLEET_SLACK_US
+#define AIRSWIMMER_FLEET_SLACK_US AirSwimmerIRProtocol::gapDuration
+#endif
+
+/**
+ * Number of packets the fleet remembers having queued, to recognize them
+ * when the receiver hears them back: every packet that can still be
+ * waiting in the TX queues or on the air.
+ */
+#define AIRSWIMMER_FLEET_ECHO_PACKETS (IR_TX_QUEUE_SIZE + 2)
+
+/**
+ * Counters kept by the fleet scheduler
+ */
+struct AirSwimmerFleetStats {
+  uint32_t frames;      // Frames queued
+  uint16_t lateFrames;  // Frames started over AIRSWIMMER_FLEET_SLACK_US late
+  uint16_t maxLateMs;   // Latest frame, in milliseconds past its due time
+  uint16_t load;        // Airtime the fleet needs, in permille of the channel
+};
+
+/**
+ * The AirSwimmerFleet interleaves the packets of several vehicles on the
+ * emitter. Each vehicle has a frame due once per gap duration, or earlier
+ * when its flap command is about to change, and the frames are queued
+ * earliest due first, back to back, so the LED idles only when no vehicle
+ * has anything due.
+ *
+ * Every frame takes about half a gap on the air, so the channel fits two
+ * flying vehicles: getStats() reports the load the fleet puts on it, and
+ * the frames that started late once it is exceeded.
+ */
+class AirSwimmerFleet : public IRProtocol<AirSwimmerIRProtocol> {
+  public:
+    AirSwimmerFleet();
+    
+    uint8_t add(AirSwimmerVehicle *);
+    void update();
+    uint8_t isOverloaded();
+    uint8_t isEcho(const uint32_t *);
+    uint8_t getVehicleTxCount(uint8_t);
+    void getStats(AirSwimmerFleetStats *);
+    void resetStats();
+    
+  private:
+    AirSwimmerVehicle *vehicles[AIRSWIMMER_FLEET_SIZE];
+    uint32_t dueTimes[AIRSWIMMER_FLEET_SIZE];
+    uint16_t airtimes[AIRSWIMMER_FLEET_SIZE];
+    uint8_t txCounts[AIRSWIMMER_FLEET_SIZE];
+    uint8_t vehicleCount;
+    
+    uint32_t sentPackets[AIRSWIMMER_FLEET_ECHO_PACKETS];
+    uint8_t sentIndex;
+    
+    uint32_t channelFreeTime;
+    AirSwimmerFleetStats stats;
+    
+    uint16_t getLoad();
+    void sendFrame(uint8_t, uint32_t);
+};
+
+#endif
@@ -15,21 +15,143 @@
  */
 #include "AirSwimmerIR.h"
 
-// Note: The IR Signature is unique to each controller. The sync routine
-// is required to ensure that this program works properly with the
-// Air Swimmers device being used.
-#define AIRSWIMMER_IR_SIGNATURE 0b0110101010111101
-#define AIRSWIMMER_IR_CHECKSUM_BASE 0b1010
+/**
+ * Low byte of the packet, command nibble and checksum, for every command
+ * nibble. It is built by the compiler and kept in flash, so encoding a
+ * packet only takes a table lookup and an OR with the signature.
+ */
+static const uint8_t packetPayloads[AIRSWIMMER_IR_COMMAND_COUNT] PROGMEM = {
+  AIRSWIMMER_IR_PAYLOAD(0),  AIRSWIMMER_IR_PAYLOAD(1),
+  AIRSWIMMER_IR_PAYLOAD(2),  AIRSWIMMER_IR_PAYLOAD(3),
+  AIRSWIMMER_IR_PAYLOAD(4),  AIRSWIMMER_IR_PAYLOAD(5),
+  AIRSWIMMER_IR_PAYLOAD(6),  AIRSWIMMER_IR_PAYLOAD(7),
+  AIRSWIMMER_IR_PAYLOAD(8),  AIRSWIMMER_IR_PAYLOAD(9),
+  AIRSWIMMER_IR_PAYLOAD(10), AIRSWIMMER_IR_PAYLOAD(11),
+  AIRSWIMMER_IR_PAYLOAD(12), AIRSWIMMER_IR_PAYLOAD(13),
+  AIRSWIMMER_IR_PAYLOAD(14), AIRSWIMMER_IR_PAYLOAD(15)
+};
+
+/**
+ * Initialize the Air Swimmer IR class. The protocol parameters are supplied
+ * at compile time by AirSwimmerIRProtocol. IR Out is enabled at the
+ * appropriate frequency by begin().
+ *
+ * @param signature IR signature of the controller being emulated
+ */
+AirSwimmerIR::AirSwimmerIR(uint16_t signature)
+: IRProtocol<AirSwimmerIRProtocol>(0, 1)
+{
+  this->lastPacketTime = 0;
+  
+  this->setSignature(signature);
+}
 
 /**
- * Initialize the Air Swimmer IR class. Configures the IR interface with the
- * necessary parameters as determined by reverse-engineering the protocol,
- * and enables IR Out at the appropriate frequency.
+ * Sets the IR signature sent with every packet
  *
- * @param rxPin Pin hooked up to the IR receiver's data line
+ * @param signature IR signature of the controller being emulated
+ */
+void AirSwimmerIR::setSignature(uint16_t signature)
+{
+  this->vehicle.setSignature(signature);
+}
+
+/**
+ * Must be called from the main loop. Once per gap duration, prepares the
+ * next packet based on the current settings and queues it for transmission.
+ * Packets are encoded here rather than in the TX interrupt, so the main loop
+ * is the only code touching the command state.
  */
-AirSwimmerIR::AirSwimmerIR()
-: IR(0, 1),
+void AirSwimmerIR::update()
+{
+  if (millis() - this->lastPacketTime < AirSwimmerIRProtocol::gapDuration / 1000) {
+    return;
+  }
+  
+  this->lastPacketTime = millis();
+  this->sendPacket();
+}
+ 
+/**
+ * Configures the packet for transmission based on the current settings,
+ * and queues it for transmission. Sync packets jump the queue.
+ */
+void AirSwimmerIR::sendPacket()
+{
+  uint8_t commands = this->vehicle.nextCommands(millis());
+  
+  // If we have not set any commands, do not send the 
+  // TX packet
+  if (commands == 0) {
+    return;
+  }
+  
+  // Encode the IR packet, with the signature and checksum, and transmit it
+  uint32_t packet = this->vehicle.getPacket(commands);
+  this->tx(&packet, this->vehicle.isSyncing());
+}
+
+/**
+ * Set the current speed for sending commands
+ *
+ * @param speed Speed at which commands should be sent (Min: 0; Max: 100)
+ */
+void AirSwimmerIR::setSpeed(uint8_t speed)
+{
+  this->vehicle.setSpeed(speed);
+}
+
+/**
+ * Prepares the next packets for a flap
+ *
+ * @param direction Direction of travel. -1 for left, 1 for right, 0 for straight
+ */
+void AirSwimmerIR::prepareFlap(int8_t direction)
+{
+  this->vehicle.prepareFlap(direction);
+}
+
+/**
+ * Prepares the next packets for a dive
+ *
+ * @param direction Direction of travel. -1 for dive, 1 for climb
+ */
+void AirSwimmerIR::prepareDive(int8_t direction)
+{
+  this->vehicle.prepareDive(direction);
+}
+
+/**
+ * Sets the sync state for the packet
+ *
+ * @param syncOn Boolean value indicating whether sync should be enabled
+ */
+void AirSwimmerIR::prepareSync(uint8_t syncOn)
+{
+  this->vehicle.prepareSync(syncOn);
+}
+
+ /**
+  * Checksum for the Air Swimmer packet. Verifies that the signature of the packet
+  * matches and ensures the command checksum is valid.
+  *
+  * @param packet IR packet to verify
+  */
+uint8_t AirSwimmerIRProtocol::checksum(const uint32_t *packet)
+{
+	return ((*packet >> 8) & 0xFFFF) == AIRSWIMMER_IR_SIGNATURE
+          && (((*packet >> 4) ^ *packet) & 0xF) == AIRSWIMMER_IR_CHECKSUM_BASE;
+}
+
+/**
+ * Construct a vehicle at rest.
+ *
+ * @param signature IR signature of the controller the vehicle is paired with
+ */
+AirSwimmerVehicle::AirSwimmerVehicle(uint16_t signature)
+: packetSignature((uint32_t)signature << AIRSWIMMER_IR_SIGNATURE_SHIFT),
+  lastFlapDirection(0),
+  currentFlapTime(0),
   overrideDelay(0),
   flapDirection(0),
   diveDirection(0),
@@ -37,115 +159,146 @@ AirSwimmerIR::AirSwimmerIR()
   lastCommandTime(0),
   syncEnabled(0)
 {
-	this->irConfig.startPulseDuration = 0;
-	this->irConfig.gapDuration        = 50000l;
-	this->irConfig.pulseGapDuration   = 340;
-	this->irConfig.shortPulseDuration = 220;
-	this->irConfig.longPulseDuration  = 720;
-	this->irConfig.pulseTolerance     = 100;
-	this->irConfig.packetBits         = 24;
-	this->irConfig.txFrequency        = 38;
-	this->irConfig.pulseInType        = HIGH;
-	this->irConfig.hasChecksum        = 1;
+}
+
+/**
+ * Encodes a packet.
+ *
+ * @param signature IR signature of the controller being emulated
+ * @param commands Command nibble (see AIRSWIMMER_IR_COMMAND_*)
+ * @return Packet carrying the signature, commands and checksum
+ */
+uint32_t AirSwimmerVehicle::encode(uint16_t signature, uint8_t commands)
+{
+  return ((uint32_t)signature << AIRSWIMMER_IR_SIGNATURE_SHIFT)
+    | pgm_read_byte(&packetPayloads[commands]);
+}
+
+/**
+ * Encodes a packet for this vehicle.
+ *
+ * @param commands Command nibble returned by nextCommands()
+ */
+uint32_t AirSwimmerVehicle::getPacket(uint8_t commands)
+{
+  return this->packetSignature | pgm_read_byte(&packetPayloads[commands]);
+}
+
+/**
+ * Sets the IR signature the vehicle answers to
+ *
+ * @param signature IR signature of the controller the vehicle is paired with
+ */
+void AirSwimmerVehicle::setSignature(uint16_t signature)
+{
+  this->packetSignature = (uint32_t)signature << AIRSWIMMER_IR_SIGNATURE_SHIFT;
+}
+
+uint16_t AirSwimmerVehicle::getSignature()
+{
+  return this->packetSignature >> AIRSWIMMER_IR_SIGNATURE_SHIFT;
+}
+
+/**
+ * Time between two flap commands, based on the current speed. The flap
+ * speed ranges from 250ms to 500ms. Increasing the speed decreases this
+ * interval.
+ *
+ * @return Delay in milliseconds
+ */
+uint32_t AirSwimmerVehicle::getFlapDelay()
+{
+  return (this->flapDirection == 0 ? 250 : 500) + 2 * (100 - this->currentSpeed);
+}
+
+/**
+ * Time left before the flap command changes, so the next packet is due no
+ * later than that.
+ *
+ * @param time Time (in milliseconds) of the last call to nextCommands()
+ * @return Delay in milliseconds (0 if already due, 0xFFFFFFFF if not flapping)
+ */
+uint32_t AirSwimmerVehicle::getFlapWait(uint32_t time)
+{
+  if (this->syncEnabled || this->currentSpeed == 0) {
+    return 0xFFFFFFFFUL;
+  }
+  
+  if (this->overrideDelay) {
+    return 0;
+  }
   
-  this->currentFlapTime = 0;
+  uint32_t elapsed = time - this->currentFlapTime;
+  uint32_t delayTime = this->getFlapDelay();
   
-  this->enableIROut(this->irConfig.txFrequency);
+  return elapsed > delayTime ? 0 : delayTime + 1 - elapsed;
 }
- 
+
 /**
- * Configures the packet for transmission based on the current settings,
- * and sends a TX command (which is processed during the next appropriate
- * timer cycle)
+ * Works out the commands of the next packet from the current settings, and
+ * advances the flap state.
+ *
+ * @param time Time (in milliseconds) at which the packet will be sent
+ * @return Command nibble, 0 if no packet should be sent
  */
-void AirSwimmerIR::sendPacket()
+uint8_t AirSwimmerVehicle::nextCommands(uint32_t time)
 {
+  uint8_t commands = 0;
+  
   // If Sync has been initialized, we configure the command packet
   // with the sync command (which is equivalent to all four commands
   // enabled at once)
   if (this->syncEnabled) {
-    this->irPacket.commandLeft = 1;
-    this->irPacket.commandRight = 1;
-    this->irPacket.commandUp = 1;
-    this->irPacket.commandDown = 1;
-  } else {
-    this->irPacket.commands = 0;
+    return AIRSWIMMER_IR_COMMAND_SYNC;
+  }
   
-    if (this->lastCommandTime < millis() - 1000) {
-      // If no commands have been received for at least a second, stop all motion
-      this->currentSpeed = 0;
-    } else {
-      // Initialize the dive command, as long as we're receiving commands     
-      if (this->diveDirection == 1) {
-        this->irPacket.commandDown = 1;
-      } else if (this->diveDirection == -1) {
-        this->irPacket.commandUp = 1;
-      }
+  if (this->lastCommandTime < time - 1000) {
+    // If no commands have been received for at least a second, stop all motion
+    this->currentSpeed = 0;
+  } else {
+    // Initialize the dive command, as long as we're receiving commands     
+    if (this->diveDirection == 1) {
+      commands |= AIRSWIMMER_IR_COMMAND_DOWN;
+    } else if (this->diveDirection == -1) {
+      commands |= AIRSWIMMER_IR_COMMAND_UP;
     }
+  }
+  
+  if (this->currentSpeed > 0) {
+    uint32_t delayTime = this->getFlapDelay();
     
-    if (this->currentSpeed > 0) {
-      // The time between subsequent flap commands is adjusted based on the
-      // current speed. The flap speed ranges from 250ms to 500ms. Increasing
-      // the speed decreases this interval.
-      uint32_t delayTime = (this->flapDirection == 0 ? 250 : 500) + 2 * (100 - this->currentSpeed);
-      
-      // Check the time of the last flap event and determine if
-      // at least 'delaytime' microseconds have elapsed. 
-      if (this->overrideDelay || this->currentFlapTime < millis() - delayTime) {
-        if (this->flapDirection == 0) { // Toggle flap direction (to fly straight)
-          // Toggle between the two flap directions
-          // (if last direction was left, flap right;
-          // otherwise, flap left).
-          if (this->lastFlapDirection == -1) {
-            this->irPacket.commandRight = 1;
-            this->lastFlapDirection = 1;
-          } else {
-            this->irPacket.commandLeft = 1;
-            this->lastFlapDirection = -1;
-          }
-        } else if (this->lastFlapDirection != 0) { // Bring flapping to idle position
-          this->lastFlapDirection = 0;
-        } else { // Flap in the direction specified
-          this->lastFlapDirection = this->flapDirection;
+    // Check the time of the last flap event and determine if
+    // at least 'delaytime' microseconds have elapsed. 
+    if (this->overrideDelay || this->currentFlapTime < time - delayTime) {
+      if (this->flapDirection == 0) { // Toggle flap direction (to fly straight)
+        // Toggle between the two flap directions
+        // (if last direction was left, flap right;
+        // otherwise, flap left).
+        if (this->lastFlapDirection == -1) {
+          commands |= AIRSWIMMER_IR_COMMAND_RIGHT;
+          this->lastFlapDirection = 1;
+        } else {
+          commands |= AIRSWIMMER_IR_COMMAND_LEFT;
+          this->lastFlapDirection = -1;
         }
-        
-        // Set the current flap time
-        this->currentFlapTime = millis();
+      } else if (this->lastFlapDirection != 0) { // Bring flapping to idle position
+        this->lastFlapDirection = 0;
+      } else { // Flap in the direction specified
+        this->lastFlapDirection = this->flapDirection;
       }
       
-      if (this->lastFlapDirection == 1) {
-        this->irPacket.commandRight = 1;
-      } else if (this->lastFlapDirection == -1) {
-        this->irPacket.commandLeft=  1;
-      }
+      // Set the current flap time
+      this->currentFlapTime = time;
+    }
+    
+    if (this->lastFlapDirection == 1) {
+      commands |= AIRSWIMMER_IR_COMMAND_RIGHT;
+    } else if (this->lastFlapDirection == -1) {
+      commands |= AIRSWIMMER_IR_COMMAND_LEFT;
     }
   }
   
-  // If we have not set any commands, do not send the 
-  // TX packet
-  if (this->irPacket.commands == 0) {
-    return;
-  }
-  
-  // Configure the packet signature and checksum prior to sending
-  // the TX packet
-  this->irPacket.signature = AIRSWIMMER_IR_SIGNATURE;
-  this->irPacket.checksum  = this->irPacket.commands ^ AIRSWIMMER_IR_CHECKSUM_BASE;
-
-  // Transmit the IR packet
-  this->tx((uint32_t *)&this->irPacket);
-}
- 
- /**
-  * Checksum for the Air Swimmer packet. Verifies that the signature of the packet
-  * matches and ensures the command checksum is valid.
-  *
-  * @param packet IR packet to verify
-  */
-uint8_t AirSwimmerIR::checksum(uint32_t *packet)
-{
-	return this->irPacket.signature == AIRSWIMMER_IR_SIGNATURE
-          && (this->irPacket.commands ^ this->irPacket.checksum) == AIRSWIMMER_IR_CHECKSUM_BASE;
+  return commands;
 }
  
 /**
@@ -153,7 +306,7 @@ uint8_t AirSwimmerIR::checksum(uint32_t *packet)
  *
  * @param speed Speed at which commands should be sent (Min: 0; Max: 100)
 */
-void AirSwimmerIR::setSpeed(uint8_t speed)
+void AirSwimmerVehicle::setSpeed(uint8_t speed)
 {
 	if (speed > 100) speed = 100;
 	 
@@ -166,9 +319,8 @@ void AirSwimmerIR::setSpeed(uint8_t speed)
  * Prepares the specified packet for a flap
  *
  * @param direction Direction of travel. -1 for left, 1 for right, 0 for straight
- * @param irPacket Packet to configure for the flap
 */
-void AirSwimmerIR::prepareFlap(int8_t direction)
+void AirSwimmerVehicle::prepareFlap(int8_t direction)
 {
   if (direction != this->flapDirection) {
     this->overrideDelay = 1;
@@ -185,9 +337,8 @@ void AirSwimmerIR::prepareFlap(int8_t direction)
  * Prepares the specified packet for a dive
  *
  * @param direction Direction of travel. -1 for dive, 1 for climb
- * @param irPacket Packet to configure for the dive
 */
-void AirSwimmerIR::prepareDive(int8_t direction)
+void AirSwimmerVehicle::prepareDive(int8_t direction)
 {
   this->diveDirection = direction;
   
@@ -199,7 +350,12 @@ void AirSwimmerIR::prepareDive(int8_t direction)
  *
  * @param syncOn Boolean value indicating whether sync should be enabled
  */
-void AirSwimmerIR::prepareSync(uint8_t syncOn)
+void AirSwimmerVehicle::prepareSync(uint8_t syncOn)
 {
   this->syncEnabled = syncOn;
 }
+
+uint8_t AirSwimmerVehicle::isSyncing()
+{
+  return this->syncEnabled;
+}
@@ -17,9 +17,32 @@
 #define AIR_SWIMMER_IR_H_
 
 #include <IR.h>
+#include <IRProtocol.h>
 
 /**
- * Structure defining the layout of the AirSwimmer IR packet.
+ * Protocol tag reported by IRMultiDecoder for Air Swimmer frames
+ */
+#define AIRSWIMMER_IR_PROTOCOL 2
+
+// Note: The IR Signature is unique to each controller. The sync routine
+// is required to ensure that this program works properly with the
+// Air Swimmers device being used.
+#define AIRSWIMMER_IR_SIGNATURE 0b0110101010111101
+#define AIRSWIMMER_IR_CHECKSUM_BASE 0b1010
+
+/**
+ * Bits of the command nibble (see AIRSWIMMER_IR_PAYLOAD). The sync command is
+ * all four commands at once.
+ */
+#define AIRSWIMMER_IR_COMMAND_RIGHT 0b0001
+#define AIRSWIMMER_IR_COMMAND_LEFT  0b0010
+#define AIRSWIMMER_IR_COMMAND_DOWN  0b0100
+#define AIRSWIMMER_IR_COMMAND_UP    0b1000
+#define AIRSWIMMER_IR_COMMAND_SYNC  0b1111
+
+/**
+ * Layout of the AirSwimmer IR packet: the signature, then the command
+ * nibble and its checksum.
  *
  *         7654 3210 FEDC BA98 7654 3210
  * Btn     THES IGNA TURE BITS  DIRS  CKSM
@@ -28,38 +51,69 @@
  * Left  - 0110 1010 1011 1101 [0010] 1000
  * Right - 0110 1010 1011 1101 [0001] 1011
  * CKSM = DIRS ^ 1010
+ *
+ * AIRSWIMMER_IR_PAYLOAD() gives the low byte for a command nibble.
  */
-struct AirSwimmerIRPacket {
-  union {
-    struct {
-      unsigned commandPadding : 4;
-      unsigned commandRight   : 1;
-      unsigned commandLeft    : 1;
-      unsigned commandDown    : 1;
-      unsigned commandUp      : 1;
-    };
-    struct {
-      unsigned checksum : 4;
-      unsigned commands : 4;
-    };
-    uint8_t payloadByte;
-  };
-  uint16_t signature;
+#define AIRSWIMMER_IR_SIGNATURE_SHIFT 8
+#define AIRSWIMMER_IR_PAYLOAD(commands) \
+  (((commands) << 4) | ((commands) ^ AIRSWIMMER_IR_CHECKSUM_BASE))
+
+/**
+ * Number of distinct command nibbles
+ */
+#define AIRSWIMMER_IR_COMMAND_COUNT 16
+
+/**
+ * Timings of the Air Swimmer IR protocol, as determined by reverse-engineering
+ * the protocol. See IRProtocol.h for a description of each field.
+ */
+struct AirSwimmerIRProtocol {
+  static const uint16_t startPulseDuration = 0;
+  static const uint32_t gapDuration        = 50000;
+  static const uint32_t frameGapDuration   = 5000;
+  static const uint16_t pulseGapDuration   = 340;
+  static const uint16_t shortPulseDuration = 220;
+  static const uint16_t longPulseDuration  = 720;
+  static const uint16_t pulseTolerance     = 100;
+  static const uint16_t trackingTolerance  = 80;
+  static const uint8_t  packetBits         = 24;
+  static const uint8_t  txFrequency        = 38;
+  static const uint8_t  pulseInType        = HIGH;
+  static const uint8_t  signatureBits      = 16;
+  static const uint32_t signature          = AIRSWIMMER_IR_SIGNATURE;
+  static const uint8_t  hasChecksum        = 1;
+  
+  static uint8_t checksum(const uint32_t *);
 };
 
-class AirSwimmerIR : public IR {
+/**
+ * Motion state of a single Air Swimmer: the signature it answers to, and
+ * the flap and dive commands it is being driven with. The packets carrying
+ * these commands are sent by an AirSwimmerIR, or by an AirSwimmerFleet
+ * when several vehicles share the emitter.
+ */
+class AirSwimmerVehicle {
   public:
-    AirSwimmerIR();
+    AirSwimmerVehicle(uint16_t = AIRSWIMMER_IR_SIGNATURE);
     
+    void setSignature(uint16_t);
+    uint16_t getSignature();
     void setSpeed(uint8_t);
     void prepareFlap(int8_t);
     void prepareDive(int8_t);
     void prepareSync(uint8_t);
+    uint8_t isSyncing();
+    
+    uint8_t nextCommands(uint32_t);
+    uint32_t getFlapWait(uint32_t);
+    uint32_t getPacket(uint8_t);
+    
+    static uint32_t encode(uint16_t, uint8_t);
     
   protected:
-    volatile AirSwimmerIRPacket irPacket;
-    volatile int8_t lastFlapDirection;
-    volatile uint32_t currentFlapTime;
+    uint32_t packetSignature;  // Signature, already shifted into place
+    int8_t lastFlapDirection;
+    uint32_t currentFlapTime;
   
     uint8_t overrideDelay;
     int8_t flapDirection;
@@ -69,8 +123,27 @@ class AirSwimmerIR : public IR {
     uint32_t lastCommandTime;
     uint8_t syncEnabled;
     
+    uint32_t getFlapDelay();
+};
+
+/**
+ * Drives a single Air Swimmer, sending a packet once per gap duration.
+ */
+class AirSwimmerIR : public IRProtocol<AirSwimmerIRProtocol> {
+  public:
+    AirSwimmerIR(uint16_t = AIRSWIMMER_IR_SIGNATURE);
+    
+    void update();
+    void setSignature(uint16_t);
+    void setSpeed(uint8_t);
+    void prepareFlap(int8_t);
+    void prepareDive(int8_t);
+    void prepareSync(uint8_t);
+    
+  protected:
+    AirSwimmerVehicle vehicle;
+    uint32_t lastPacketTime;
     
-    virtual uint8_t checksum(uint32_t *);
-    virtual void sendPacket();
+    void sendPacket();
 };
 #endif
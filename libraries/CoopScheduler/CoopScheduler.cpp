@@ -0,0 +1,194 @@
+/**
+ * Coop Scheduler
+ *
+ * This library runs the tasks of a sketch's main loop cooperatively,
+ * earliest deadline first.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "CoopScheduler.h"
+
+/**
+ * Construct a scheduler with no tasks.
+ */
+CoopScheduler::CoopScheduler()
+  : stats(),
+    taskCount(0),
+    armed(0)
+{
+}
+
+/**
+ * Adds a task. A periodic task is first due right away.
+ *
+ * @param function Function run by the task
+ * @param period Time between two runs, in microseconds. 0 if the task
+ *               only runs when woken up (see wake()).
+ * @return Identifier of the task, COOP_NO_TASK if there is no room left
+ */
+uint8_t CoopScheduler::add(CoopTaskFunction function, uint32_t period)
+{
+  if (this->taskCount == COOP_MAX_TASKS) {
+    return COOP_NO_TASK;
+  }
+  
+  uint8_t task = this->taskCount++;
+  
+  this->functions[task] = function;
+  this->periods[task] = period;
+  this->dueTimes[task] = micros();
+  
+  if (period) {
+    this->armed |= _BV(task);
+  }
+  
+  return task;
+}
+
+/**
+ * Makes a task due right away. Must be called from the main loop, not from
+ * an interrupt.
+ *
+ * @param task Identifier returned by add()
+ */
+void CoopScheduler::wake(uint8_t task)
+{
+  if (!(this->armed & _BV(task))) {
+    this->armed |= _BV(task);
+    this->dueTimes[task] = micros();
+  } else if (!this->periods[task] || (int32_t)(this->dueTimes[task] - micros()) > 0) {
+    this->dueTimes[task] = micros();
+  }
+}
+
+/**
+ * Task with the earliest due time, due or not
+ *
+ * @return Identifier of the task, COOP_NO_TASK if no task is armed
+ */
+uint8_t CoopScheduler::nextTask()
+{
+  uint8_t next = COOP_NO_TASK;
+  
+  for (uint8_t task = 0; task < this->taskCount; ++task) {
+    if ((this->armed & _BV(task))
+        && (next == COOP_NO_TASK || (int32_t)(this->dueTimes[task] - this->dueTimes[next]) < 0)) {
+      next = task;
+    }
+  }
+  
+  return next;
+}
+
+/**
+ * Must be called from the main loop. Runs the task with the earliest due
+ * time, if it is due. A periodic task is then due one period later; if it
+ * ran over a full period late, the missed runs are skipped rather than
+ * run back to back.
+ *
+ * @return Boolean indicating whether a task ran
+ */
+uint8_t CoopScheduler::run()
+{
+  uint8_t task = this->nextTask();
+  uint32_t startTime = micros();
+  
+  if (task == COOP_NO_TASK || (int32_t)(this->dueTimes[task] - startTime) > 0) {
+    return 0;
+  }
+  
+  uint32_t late = startTime - this->dueTimes[task];
+  
+  if (this->periods[task]) {
+    this->dueTimes[task] += this->periods[task];
+    
+    if ((int32_t)(this->dueTimes[task] - startTime) <= 0) {
+      this->dueTimes[task] = startTime + this->periods[task];
+    }
+  } else {
+    this->armed &= ~_BV(task);
+  }
+  
+  this->functions[task]();
+  
+  uint32_t runTime = micros() - startTime;
+  CoopTaskStats *stats = &this->stats[task];
+  
+  ++stats->runs;
+  
+  if (runTime > stats->maxRunUs) {
+    stats->maxRunUs = runTime > 0xFFFF ? 0xFFFF : runTime;
+  }
+  
+  if (late > stats->maxLateUs) {
+    stats->maxLateUs = late > 0xFFFF ? 0xFFFF : late;
+  }
+  
+  return 1;
+}
+
+/**
+ * Time left before the next task is due
+ *
+ * @return Time in microseconds, 0 if a task is due, 0xFFFFFFFF if every
+ *         task is waiting to be woken up
+ */
+uint32_t CoopScheduler::getWait()
+{
+  uint8_t task = this->nextTask();
+  
+  if (task == COOP_NO_TASK) {
+    return 0xFFFFFFFFUL;
+  }
+  
+  int32_t wait = this->dueTimes[task] - micros();
+  
+  return wait > 0 ? wait : 0;
+}
+
+/**
+ * Longest run of any task, which bounds the time a pass of the main loop
+ * takes
+ *
+ * @return Time in microseconds
+ */
+uint16_t CoopScheduler::getMaxRunTime()
+{
+  uint16_t maxRunUs = 0;
+  
+  for (uint8_t task = 0; task < this->taskCount; ++task) {
+    if (this->stats[task].maxRunUs > maxRunUs) {
+      maxRunUs = this->stats[task].maxRunUs;
+    }
+  }
+  
+  return maxRunUs;
+}
+
+/**
+ * Copies a task's counters.
+ *
+ * @param task Identifier returned by add()
+ * @param stats Variable that will store the counters
+ */
+void CoopScheduler::getStats(uint8_t task, CoopTaskStats *stats)
+{
+  *stats = this->stats[task];
+}
+
+/**
+ * Clears every task's counters.
+ */
+void CoopScheduler::resetStats()
+{
+  for (uint8_t task = 0; task < this->taskCount; ++task) {
+    this->stats[task] = CoopTaskStats();
+  }
+}
@@ -0,0 +1,91 @@
+/**
+ * Coop Scheduler
+ *
+ * This library runs the tasks of a sketch's main loop cooperatively,
+ * earliest deadline first.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _COOP_SCHEDULER_H_
+#define _COOP_SCHEDULER_H_
+
+// The host build declares the Arduino functions in its own shim
+#ifdef __AVR__
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+#else
+#include <ArduinoHost.h>
+#endif
+#include <inttypes.h>
+
+/**
+ * Maximum number of tasks. Cannot exceed 8.
+ */
+#ifndef COOP_MAX_TASKS
+#define COOP_MAX_TASKS 8
+#endif
+
+/**
+ * Task identifier returned by CoopScheduler::add() when no task is added
+ */
+#define COOP_NO_TASK 0xFF
+
+/**
+ * Function run by a task. It must return once its work is done, as no
+ * other task runs in the meantime.
+ */
+typedef void (*CoopTaskFunction)();
+
+/**
+ * Counters kept for each task. Times are in microseconds, saturated at
+ * 0xFFFF.
+ */
+struct CoopTaskStats {
+  uint32_t runs;       // Times the task ran
+  uint16_t maxRunUs;   // Longest run
+  uint16_t maxLateUs;  // Latest start, past the time the task was due
+};
+
+/**
+ * The CoopScheduler holds a fixed set of tasks, each run every period, or
+ * only when woken up if its period is 0. Every call to run() runs the due
+ * task with the earliest due time to completion, so a pass of the main
+ * loop lasts no longer than the longest task, and a task waits for at most
+ * one pass per task due ahead of it. getStats() measures both.
+ *
+ * Times are read with micros(), so periods are limited to 35 minutes.
+ */
+class CoopScheduler {
+  public:
+    CoopScheduler();
+    
+    uint8_t add(CoopTaskFunction, uint32_t);
+    void wake(uint8_t);
+    uint8_t run();
+    uint32_t getWait();
+    uint16_t getMaxRunTime();
+    void getStats(uint8_t, CoopTaskStats *);
+    void resetStats();
+    
+  private:
+    CoopTaskFunction functions[COOP_MAX_TASKS];
+    uint32_t periods[COOP_MAX_TASKS];
+    uint32_t dueTimes[COOP_MAX_TASKS];
+    CoopTaskStats stats[COOP_MAX_TASKS];
+    uint8_t taskCount;
+    uint8_t armed;
+    
+    uint8_t nextTask();
+};
+
+#endif
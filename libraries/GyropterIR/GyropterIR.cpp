@@ -15,75 +15,71 @@
  * http://blog.geekken.net/2013/03/23/masters-project-final-report/
  */
 #include "GyropterIR.h"
+#include "GyropterIRCurve.h"
 
 /**
- * Initialize the Gyropter IR class. Configures the IR interface with the
- * necessary parameters as determined by reverse-engineering the protocol.
+ * Response curves of the joystick axes, indexed by the raw field value (see
+ * GyropterIRCurve.h). They are built by the compiler and kept in flash.
+ */
+static const uint8_t throttleCurve[64] PROGMEM = {
+  GYROPTER_IR_TABLE_64(GYROPTER_IR_THROTTLE, 0)
+};
+
+static const int8_t horizontalCurve[256] PROGMEM = {
+  GYROPTER_IR_TABLE_256(GYROPTER_IR_HORIZONTAL, 0)
+};
+
+static const int8_t verticalCurve[8] PROGMEM = {
+  GYROPTER_IR_TABLE_8(GYROPTER_IR_VERTICAL, 0)
+};
+
+/**
+ * Initialize the Gyropter IR class. The protocol parameters are supplied
+ * at compile time by GyropterIRProtocol.
  *
  * @param rxPin Pin hooked up to the IR receiver's data line
  */
 GyropterIR::GyropterIR(uint8_t rxPin)
-    : IR(rxPin, 0) 
+    : IRProtocol<GyropterIRProtocol>(rxPin, 0) 
 {
-    this->irConfig.startPulseDuration    = 5000l;
-    this->irConfig.gapDuration           = 120000l;
-    this->irConfig.pulseGapDuration      = 1000l;
-    this->irConfig.shortPulseDuration    = 1000l;
-    this->irConfig.longPulseDuration     = 2800l;
-    this->irConfig.pulseTolerance        = 300l;
-    this->irConfig.packetBits            = 21;
-    this->irConfig.txFrequency           = 38;
-    this->irConfig.pulseInType           = LOW;
-    this->irConfig.hasChecksum           = 0;
 }
 
 /**
  * Converts an incoming packet to a standardized command packet, where directions
- * are converted to percentages.
+ * are converted to percentages by the response curves.
  *
  * @param packet Pointer to the IR packet
  * @param commandPacket Output variable where the command packet is stored
  */
 void GyropterIR::getCommandPacket(uint32_t *packet, GyropterIRCommand *commandPacket)
 {
-  GyropterIRPacket *irPacket = (GyropterIRPacket *)packet;
-  
-  // Initialize the command packet
-  commandPacket->upPercent    = 0;
-  commandPacket->downPercent  = 0;
-  commandPacket->leftPercent  = 0;
-  commandPacket->rightPercent = 0;
+  // Fields are extracted with shifts rather than through GyropterIRPacket, as
+  // bitfield layout is up to the compiler (see GyropterIRPacket for the bits)
+  int8_t vertical   = pgm_read_byte(&verticalCurve[(*packet >> 2) & 0x7]);
+  int8_t horizontal = pgm_read_byte(&horizontalCurve[(*packet >> 5) & 0xFF]);
   
-  if (irPacket->joyRightVertical < 4) {
-    commandPacket->upPercent = (4 - irPacket->joyRightVertical) * 100 / 4;
-  } else {
-    commandPacket->downPercent = (irPacket->joyRightVertical - 4) * 100 / 4;
-  }
+  commandPacket->upPercent    = vertical > 0 ? vertical : 0;
+  commandPacket->downPercent  = vertical < 0 ? -vertical : 0;
+  commandPacket->leftPercent  = horizontal > 0 ? horizontal : 0;
+  commandPacket->rightPercent = horizontal < 0 ? -horizontal : 0;
   
-  if (irPacket->joyRightHorizontal < 115) {
-    commandPacket->rightPercent = (115 - irPacket->joyRightHorizontal) * 100 / 115;
-  } else if (irPacket->joyRightHorizontal <= 215) {
-    commandPacket->leftPercent = (irPacket->joyRightHorizontal - 115);
-  }
+  commandPacket->throttlePercent = pgm_read_byte(&throttleCurve[(*packet >> 13) & 0x3F]);
   
-  commandPacket->throttlePercent = irPacket->joyLeft * 100 / 63;
+  commandPacket->lightToggle = *packet & 0x1;
   
-  commandPacket->lightToggle = irPacket->light;
+  commandPacket->channel = getChannel(packet);
 }
 
 /**
- * The GyropterIR packet does not have a checksum, so this method
- * just returns a false value.
+ * Reads the channel the remote is set to.
+ *
+ * @param packet Pointer to the IR packet
+ * @return One of the GYROPTER_IR_CHANNEL_* values, or GYROPTER_IR_CHANNELS
+ *         if the field holds no valid channel
  */
-uint8_t GyropterIR::checksum(uint32_t *packet) 
+uint8_t GyropterIR::getChannel(const uint32_t *packet)
 {
-  return 0;
+  // The unused field value 3 is GYROPTER_IR_CHANNELS itself
+  return (*packet >> 19) & 0x3;
 }
 
-/**
- * This method is not implemented in the GyropterIR library.
- */
-void GyropterIR::sendPacket()
-{
-
-}
@@ -18,6 +18,49 @@
 #define GYROPTER_IR_H_
 
 #include <IR.h>
+#include <IRProtocol.h>
+
+/**
+ * Protocol tag reported by IRMultiDecoder for Gyropter frames
+ */
+#define GYROPTER_IR_PROTOCOL 1
+
+/**
+ * Values of the channel field (see GyropterIRPacket), set by the A/B/C
+ * switch on the remote. Remotes on different channels can be flown side by
+ * side; the field value doubles as the index of the channel's command slot.
+ */
+#define GYROPTER_IR_CHANNEL_A 0
+#define GYROPTER_IR_CHANNEL_C 1
+#define GYROPTER_IR_CHANNEL_B 2
+#define GYROPTER_IR_CHANNELS  3
+
+/**
+ * Timings of the Gyropter IR protocol, as determined by reverse-engineering
+ * the protocol. See IRProtocol.h for a description of each field.
+ */
+struct GyropterIRProtocol {
+  static const uint16_t startPulseDuration = 5000;
+  static const uint32_t gapDuration        = 120000;
+  static const uint32_t frameGapDuration   = 120000;
+  static const uint16_t pulseGapDuration   = 1000;
+  static const uint16_t shortPulseDuration = 1000;
+  static const uint16_t longPulseDuration  = 2800;
+  static const uint16_t pulseTolerance     = 300;
+  static const uint16_t trackingTolerance  = 250;
+  static const uint8_t  packetBits         = 21;
+  static const uint8_t  txFrequency        = 38;
+  static const uint8_t  pulseInType        = LOW;
+  static const uint8_t  signatureBits      = 0;
+  static const uint32_t signature          = 0;
+  static const uint8_t  hasChecksum        = 0;
+  
+  /**
+   * The GyropterIR packet does not have a checksum, so this method
+   * just returns a false value.
+   */
+  static uint8_t checksum(const uint32_t *) { return 0; }
+};
 
 /**
  * IR packet structure for the Gyropter Remote
@@ -47,7 +90,8 @@ struct GyropterIRPacket {
 /**
  * The GyropterIRCommand structure is used to abstract away the Gyropter IR packet,
  * so programs that utilize this library do not need to know the specific packet
- * structure.
+ * structure. Each percentage follows its axis' response curve, which is set at
+ * compile time (see GyropterIRCurve.h).
  */
 struct GyropterIRCommand {
    uint8_t upPercent;
@@ -56,6 +100,7 @@ struct GyropterIRCommand {
    uint8_t rightPercent;
    uint8_t throttlePercent;
    uint8_t lightToggle;
+   uint8_t channel;
 };
 
 /**
@@ -64,12 +109,11 @@ struct GyropterIRCommand {
  * Gyropter IR packets.
  */
 class GyropterIR 
-  : public IR {
+  : public IRProtocol<GyropterIRProtocol> {
   public:
     GyropterIR(uint8_t);
     void getCommandPacket(uint32_t *, GyropterIRCommand *);
-  protected:
-    virtual uint8_t checksum(uint32_t *);
-    virtual void sendPacket();
+    
+    static uint8_t getChannel(const uint32_t *);
 };
 #endif
\ No newline at end of file
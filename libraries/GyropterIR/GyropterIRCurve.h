@@ -0,0 +1,144 @@
+/**
+ * Gyropter IR Curve
+ *
+ * This library generates, at compile time, the tables that map the joystick
+ * fields of a Gyropter packet to command percentages.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef GYROPTER_IR_CURVE_H_
+#define GYROPTER_IR_CURVE_H_
+
+/**
+ * Calibration of each joystick axis: the raw field value at rest and at
+ * full deflection, as sent by a stock remote (see GyropterIRPacket). Values
+ * past full deflection map to 100%.
+ */
+#ifndef GYROPTER_IR_THROTTLE_MIN
+#define GYROPTER_IR_THROTTLE_MIN 0
+#endif
+#ifndef GYROPTER_IR_THROTTLE_MAX
+#define GYROPTER_IR_THROTTLE_MAX 63
+#endif
+
+#ifndef GYROPTER_IR_HORIZONTAL_RIGHT
+#define GYROPTER_IR_HORIZONTAL_RIGHT 0
+#endif
+#ifndef GYROPTER_IR_HORIZONTAL_CENTER
+#define GYROPTER_IR_HORIZONTAL_CENTER 115
+#endif
+#ifndef GYROPTER_IR_HORIZONTAL_LEFT
+#define GYROPTER_IR_HORIZONTAL_LEFT 215
+#endif
+
+#ifndef GYROPTER_IR_VERTICAL_UP
+#define GYROPTER_IR_VERTICAL_UP 0
+#endif
+#ifndef GYROPTER_IR_VERTICAL_CENTER
+#define GYROPTER_IR_VERTICAL_CENTER 4
+#endif
+#ifndef GYROPTER_IR_VERTICAL_DOWN
+#define GYROPTER_IR_VERTICAL_DOWN 7
+#endif
+
+/**
+ * Handling of each axis. The deadband is the number of raw units around
+ * the rest position that still map to 0%. Expo (0 to 100) is the share of
+ * a cubic curve blended into the linear response: it softens the stick
+ * around the rest position while keeping full deflection at 100%.
+ */
+#ifndef GYROPTER_IR_THROTTLE_DEADBAND
+#define GYROPTER_IR_THROTTLE_DEADBAND 0
+#endif
+#ifndef GYROPTER_IR_THROTTLE_EXPO
+#define GYROPTER_IR_THROTTLE_EXPO 0
+#endif
+
+#ifndef GYROPTER_IR_HORIZONTAL_DEADBAND
+#define GYROPTER_IR_HORIZONTAL_DEADBAND 0
+#endif
+#ifndef GYROPTER_IR_HORIZONTAL_EXPO
+#define GYROPTER_IR_HORIZONTAL_EXPO 0
+#endif
+
+#ifndef GYROPTER_IR_VERTICAL_DEADBAND
+#define GYROPTER_IR_VERTICAL_DEADBAND 0
+#endif
+#ifndef GYROPTER_IR_VERTICAL_EXPO
+#define GYROPTER_IR_VERTICAL_EXPO 0
+#endif
+
+/**
+ * Distance of a raw value from the rest position, counted towards the given
+ * end of the axis (negative on the other side of the rest position)
+ */
+#define GYROPTER_IR_DISTANCE(x, center, end) \
+  ((end) > (center) ? (x) - (center) : (center) - (x))
+
+/**
+ * Linear response, in percent, of one half of an axis
+ */
+#define GYROPTER_IR_LINEAR(x, center, end, deadband) \
+  (GYROPTER_IR_DISTANCE(x, center, end) <= (deadband) ? 0 : \
+   GYROPTER_IR_DISTANCE(x, center, end) >= GYROPTER_IR_DISTANCE(end, center, end) ? 100 : \
+   (GYROPTER_IR_DISTANCE(x, center, end) - (deadband)) * 100 / \
+   (GYROPTER_IR_DISTANCE(end, center, end) - (deadband)))
+
+/**
+ * Blends a cubic curve into a linear response (both in percent). The
+ * arithmetic is done on longs, as the cube overflows the AVR's 16-bit int.
+ */
+#define GYROPTER_IR_EXPO(linear, expo) \
+  (((long)(linear) * (100 - (expo)) + (long)(linear) * (linear) * (linear) / 10000 * (expo)) / 100)
+
+/**
+ * Response, in percent, of one half of an axis
+ */
+#define GYROPTER_IR_CURVE(x, center, end, deadband, expo) \
+  GYROPTER_IR_EXPO(GYROPTER_IR_LINEAR(x, center, end, deadband), expo)
+
+/**
+ * Table entries for each axis. The stick axes are signed: left and up are
+ * positive, right and down negative.
+ */
+#define GYROPTER_IR_THROTTLE(x) \
+  GYROPTER_IR_CURVE(x, GYROPTER_IR_THROTTLE_MIN, GYROPTER_IR_THROTTLE_MAX, \
+                    GYROPTER_IR_THROTTLE_DEADBAND, GYROPTER_IR_THROTTLE_EXPO)
+
+#define GYROPTER_IR_HORIZONTAL(x) \
+  (GYROPTER_IR_CURVE(x, GYROPTER_IR_HORIZONTAL_CENTER, GYROPTER_IR_HORIZONTAL_LEFT, \
+                     GYROPTER_IR_HORIZONTAL_DEADBAND, GYROPTER_IR_HORIZONTAL_EXPO) - \
+   GYROPTER_IR_CURVE(x, GYROPTER_IR_HORIZONTAL_CENTER, GYROPTER_IR_HORIZONTAL_RIGHT, \
+                     GYROPTER_IR_HORIZONTAL_DEADBAND, GYROPTER_IR_HORIZONTAL_EXPO))
+
+#define GYROPTER_IR_VERTICAL(x) \
+  (GYROPTER_IR_CURVE(x, GYROPTER_IR_VERTICAL_CENTER, GYROPTER_IR_VERTICAL_UP, \
+                     GYROPTER_IR_VERTICAL_DEADBAND, GYROPTER_IR_VERTICAL_EXPO) - \
+   GYROPTER_IR_CURVE(x, GYROPTER_IR_VERTICAL_CENTER, GYROPTER_IR_VERTICAL_DOWN, \
+                     GYROPTER_IR_VERTICAL_DEADBAND, GYROPTER_IR_VERTICAL_EXPO))
+
+/**
+ * Initializers of tables holding entry(x) for 2^n consecutive raw values,
+ * starting at x
+ */
+#define GYROPTER_IR_TABLE_4(entry, x) \
+  entry(x), entry((x) + 1), entry((x) + 2), entry((x) + 3)
+#define GYROPTER_IR_TABLE_8(entry, x) \
+  GYROPTER_IR_TABLE_4(entry, x), GYROPTER_IR_TABLE_4(entry, (x) + 4)
+#define GYROPTER_IR_TABLE_16(entry, x) \
+  GYROPTER_IR_TABLE_8(entry, x), GYROPTER_IR_TABLE_8(entry, (x) + 8)
+#define GYROPTER_IR_TABLE_64(entry, x) \
+  GYROPTER_IR_TABLE_16(entry, x), GYROPTER_IR_TABLE_16(entry, (x) + 16), \
+  GYROPTER_IR_TABLE_16(entry, (x) + 32), GYROPTER_IR_TABLE_16(entry, (x) + 48)
+#define GYROPTER_IR_TABLE_256(entry, x) \
+  GYROPTER_IR_TABLE_64(entry, x), GYROPTER_IR_TABLE_64(entry, (x) + 64), \
+  GYROPTER_IR_TABLE_64(entry, (x) + 128), GYROPTER_IR_TABLE_64(entry, (x) + 192)
+
+#endif
@@ -11,26 +11,66 @@
  *
  * An in-depth analysis of this project can be found at:
  * http://blog.geekken.net/2013/03/23/masters-project-final-report/
- *
- * PWM logic taken with modifications from:
- * https://github.com/shirriff/Arduino-IRremote/blob/master/IRremoteInt.h
  */
 #include "IR.h"
-#include <avr/interrupt.h>
 
-#define SYSCLOCK 16000000  // main Arduino clock
+// Instance reference to the IR class. This is used solely for the TIMER1 ISR
+IR *instance;
+
+// Instance reference to the receiving IR class. This is used solely for the
+// pin change ISRs
+IR *rxInstance;
 
-#define TIMER_PWM_PIN 3
+// Pulses captured by the pin change ISRs, waiting to be decoded by IR::poll()
+IRPulseBuffer pulseBuffer;
 
-// Instance reference to the IR class. This is used solely for the TIMER2 ISR
-IR *instance;
+// Packets encoded by the main loop, waiting to be played back by the TIMER1 ISR.
+// Packets in the priority queue are sent before any packet in the normal queue.
+IRFrameQueue<IRTxFrame, IR_TX_QUEUE_SIZE> IR::txQueue;
+IRFrameQueue<IRTxFrame, 1> IR::txPriorityQueue;
+
+// Level of the RX pin, TX timer count at its last change, and whether the
+// pulse since then has run past IR_RX_TIMEOUT_TICKS (and was stored)
+volatile uint8_t IR::rxLevel;
+volatile uint16_t IR::rxEdgeTicks;
+volatile uint8_t IR::rxSaturated;
+
+// RX and TX edges handled so far, modulo 256 (see IRPower)
+volatile uint8_t IR::rxEdgeCount;
+volatile uint8_t IR::txEdgeCount;
+
+// Phases of the TX ISR's walk through a packet (see IR::nextTxEdge())
+#define IR_TX_LEAD  0  // Gap before the start pulse
+#define IR_TX_START 1  // Start pulse
+#define IR_TX_GAP   2  // Gap before the next bit, or the trailing gap
+#define IR_TX_BIT   3  // Pulse of the next bit
+#define IR_TX_IDLE  4  // Idle time after the packet
+#define IR_TX_DONE  5  // Last edge started
+
+// Packet being played back by the TIMER1 ISR, the queue it comes from, and
+// the position in the packet: the word and mask of the next bit, and the
+// number of bits and idle ticks left
+IRTxFrame *IR::txFrame;
+uint8_t IR::txFromPriority;
+uint8_t IR::txPhase;
+const uint32_t *IR::txWord;
+uint32_t IR::txMask;
+uint8_t IR::txBitsLeft;
+uint32_t IR::txIdleTicks;
+volatile uint8_t IR::txEnabled;
+
+// Packets queued and started so far, and the TX statistics
+uint8_t IR::txQueuedCount;
+volatile uint8_t IR::txStartCount;
+volatile uint32_t IR::txStartTime;
+IRTxStats IR::txStats;
 
 /**
- * Interrupt Service Routine configured to run on TIMER2 overflows. This needs to be
- * defined outside of the IR class, which leads to the requirement to have an
- * instance variable for the ISR to reference.
+ * Entry point of the TX timer interrupt (see IRHal.h). The interrupt handler
+ * needs to be defined outside of the IR class, which leads to the requirement
+ * to have an instance variable for it to reference.
  */
-ISR(TIMER2_OVF_vect)
+void IR::handleTxInterrupt()
 {
   if (instance) {
     instance->handleTx();
@@ -38,301 +78,520 @@ ISR(TIMER2_OVF_vect)
 }
 
 /**
- * Construct a new instance of the IR class. Sets the RX pin based
- * on the passed-in argument, and configure TX functionality if necessary
+ * Entry point of the RX pin change interrupt (see IRHal.h).
+ */
+void IR::handleRxInterrupt()
+{
+  if (rxInstance) {
+    rxInstance->handleRxEdge();
+  }
+}
+
+/**
+ * Entry point of the RX timeout interrupt (see IRHal.h).
+ */
+void IR::handleRxTimeoutInterrupt()
+{
+  if (rxInstance) {
+    rxInstance->handleRxTimeout();
+  }
+}
+
+/**
+ * Construct a new instance of the IR class. Only records the configuration;
+ * the hardware is set up by begin().
  *
  * @param rxPin Pin hooked up to the IR receiver's data line
  * @param enableTx Boolean flag indicating whether to enable TX
  */
 IR::IR(uint8_t rxPin, uint8_t enableTx) 
-  : initialized(0),
-    txEnabled(0),
-    currentPacketBit(0),
-    inPulseGap(0),
-    startPulseSent(0),
-    currentPulseDelay(0),
-    lastBitTime(0),
-    lastPacketTime(0)
+  : rxPin(rxPin),
+    pulseTap(0),
+    txCapable(enableTx)
 {
-  this->rxPin = rxPin;
-  
-  // Set the pin mode for the RX pin
+}
+
+/**
+ * Starts capturing pulses on the RX pin (if any), and makes this instance
+ * the one driven by the TX ISR if TX is enabled. Must be called from
+ * setup(), as the Arduino core configures the timers before setup() runs.
+ */
+void IR::begin()
+{
+  // Set the pin mode for the RX pin, and start capturing pulses
   if (this->rxPin > 0) {
     pinMode(this->rxPin, INPUT); 
+    this->enableIRIn();
   }
   
-  if (enableTx) {
+  if (this->txCapable) {
     // Set the instance variable for the ISR
     instance = this;
-    
-    // Let the timer know that the the class has been initialized,
-    // and TX packets can be sent
-    this->initialized = 1;
   }
 }
 
 /**
- * Method called by the TIMER2 Interrupt Service Routine. Transmits each
- * bit of the current TX packet.
+ * Method called by the TIMER1 Interrupt Service Routine at each TX edge.
+ * Switches the LED to the next edge of the packet and schedules the compare
+ * match for the following edge. Between packets, the next one is taken from
+ * the priority queue first, then from the normal queue. When both are
+ * empty, the interrupt is disabled until endTx() publishes a new packet.
+ *
+ * The carrier generator only runs from the first edge of a packet to its
+ * trailing gap, and is stopped through the idle time between packets.
  */
 void IR::handleTx()
 {
-  // If the IR configuration's gap duration has expired since the last packet was sent,
-  // call the 'sendPacket()' method, which initializes the IR packet for transmission
-  if (this->lastPacketTime < millis() - 50/*(this->irConfig.gapDuration / 1000)*/) {
-    this->lastPacketTime = millis();
-    this->sendPacket();
-  }
+  uint16_t entryTicks = IRHal::txTimerCount();
+  uint8_t starting = !txFrame;
+  
+  ++txEdgeCount;
+  
+  if (starting) {
+    txFromPriority = !txPriorityQueue.isEmpty();
+    txFrame = txFromPriority ? txPriorityQueue.front() : txQueue.front();
     
-  // If TX is not enabled (for instance, if no commands have been received from the
-  // IR controller), turn the IR transmitter off
-  if (!this->txEnabled) {
-    this->irOff();
-    return;
+    if (!txFrame) {
+      IRHal::txTimerDisarm();
+      txEnabled = 0;
+      this->irOff();
+      this->countTx(entryTicks);
+      return;
+    }
+    
+    const IRTxTimings *timings = txFrame->timings;
+    
+    txPhase = timings->startEdge ? IR_TX_LEAD : IR_TX_GAP;
+    txWord = txFrame->words;
+    txMask = timings->bits > 32 ? 0x80000000UL : timings->lastMask;
+    txBitsLeft = timings->bits;
+    txIdleTicks = timings->idleTicks;
+    
+    IRHal::carrierStart();
   }
   
-  // If we've reached the end of the current packet, disable TX and turn the IR
-  // transmitter off
-  if (this->currentPacketBit == 255) {
-    this->txEnabled = 0;
+  IREdge edge = this->nextTxEdge();
+  
+  if (edge & IR_EDGE_LEVEL) {
+    this->irOn();
+  } else {
     this->irOff();
-    return;
+    
+    if (txPhase >= IR_TX_IDLE) {
+      IRHal::carrierStop();
+    }
   }
   
+  // Lateness of the edge just switched, against the compare match that
+  // scheduled it
+  uint16_t lateTicks = IRHal::txTimerCount() - IRHal::txTimerCompare();
   
-  // If we have not sent the start pulse for the current packet, and the IR
-  // configuration has defined a start pulse duration, transmit the start pulse.
-  // NOTE: as the Air Swimmer packet does not utilize a start bit, this
-  // functionality is untested and incomplete.
-  /*if (this->irConfig.startPulseDuration > 0 && !this->startPulseSent) {
-    this->startPulseSent = 1;
-    this->currentPulseDelay = this->irConfig.startPulseDuration;
-    this->irOn();
+  if (lateTicks > IR_TX_LATE_TICKS && txStats.lateEdges < 0xFFFF) {
+    ++txStats.lateEdges;
+  }
+  if (lateTicks > txStats.maxLateTicks) {
+    txStats.maxLateTicks = lateTicks;
+  }
+  
+  // The start time is read once the edge is out and timed, as micros() is slow
+  if (starting) {
+    ++txStartCount;
+    txStartTime = micros();
+  }
+  
+  // Schedule the next edge relative to the compare match that started this
+  // one, so interrupt latency does not accumulate across edges
+  IRHal::txTimerNext(edge & IR_MAX_EDGE_TICKS);
+  
+  // Once the last edge has started, the slot is no longer needed
+  if (txPhase == IR_TX_DONE) {
+    if (txFromPriority) {
+      txPriorityQueue.pop();
+    } else {
+      txQueue.pop();
+    }
     
-    return;
-  }*/
+    txFrame = 0;
+  }
   
-  // Current pulse delay hasn't expired; stop processing
-  if (this->lastBitTime > micros() - this->currentPulseDelay) {
-    return;
+  this->countTx(entryTicks);
+}
+
+/**
+ * Generates the next edge of the packet being sent, and advances the
+ * position in the packet. Each bit costs a mask test and a shift, whatever
+ * the length of the packet. Idle times longer than a single edge can hold
+ * are split across several edges.
+ *
+ * @return Edge to switch to
+ */
+IREdge IR::nextTxEdge()
+{
+  const IRTxTimings *timings = txFrame->timings;
+  IREdge edge;
+  
+  switch (txPhase) {
+    case IR_TX_LEAD:
+      txPhase = IR_TX_START;
+      return timings->gapEdge;
+      
+    case IR_TX_START:
+      txPhase = IR_TX_GAP;
+      return timings->startEdge;
+      
+    case IR_TX_GAP:
+      txPhase = txBitsLeft ? IR_TX_BIT : IR_TX_IDLE;
+      return timings->gapEdge;
+      
+    case IR_TX_BIT:
+      edge = (*txWord & txMask) ? timings->longEdge : timings->shortEdge;
+      txMask >>= 1;
+      
+      // The last word only holds the packet's remaining bits
+      if (--txBitsLeft && !txMask) {
+        ++txWord;
+        txMask = txBitsLeft > 32 ? 0x80000000UL : timings->lastMask;
+      }
+      
+      txPhase = IR_TX_GAP;
+      return edge;
+      
+    default:
+      edge = txIdleTicks > IR_MAX_EDGE_TICKS ? IR_MAX_EDGE_TICKS : txIdleTicks;
+      txIdleTicks -= edge;
+      
+      if (!txIdleTicks) {
+        txPhase = IR_TX_DONE;
+      }
+      return edge;
   }
+}
+
+/**
+ * Counts a TX ISR invocation in the TX statistics.
+ *
+ * @param entryTicks TX timer count on entry to the ISR
+ */
+void IR::countTx(uint16_t entryTicks)
+{
+  uint16_t cycles = (uint16_t)(IRHal::txTimerCount() - entryTicks) * IR_TX_CYCLES_PER_TICK;
   
-  // If we haven't yet sent a gap pulse, configure the transmitter
-  // to send the pulse gap
-  if (!this->inPulseGap) {
-    this->inPulseGap = 1;
-    this->currentPulseDelay = this->irConfig.pulseGapDuration;
-    this->markGap();
+  ++txStats.interrupts;
+  txStats.totalCycles += cycles;
   
-    return;
+  if (cycles > txStats.maxCycles) {
+    txStats.maxCycles = cycles;
   }
+}
+
+/**
+ * Producer side of the TX queues: returns the slot to encode the next
+ * packet into.
+ *
+ * @param priority Boolean flag indicating whether the packet should be sent
+ *                 ahead of the packets already queued
+ * @return Slot for the packet, or 0 if the queue is full
+ */
+IRTxFrame *IR::beginTx(uint8_t priority)
+{
+  IRTxFrame *frame = priority ? txPriorityQueue.back() : txQueue.back();
   
-  // We are no longer in a pulse gap
-  this->inPulseGap = 0;
+  if (!frame && txStats.droppedFrames < 0xFFFF) {
+    ++txStats.droppedFrames;
+  }
   
-  // Configure the pulse delay based on the current packet bit.
-  if (bitRead(this->packetBuffer, this->currentPacketBit - 1)) {
-    this->currentPulseDelay = this->irConfig.longPulseDuration;
+  return frame;
+}
+
+/**
+ * Publishes a packet written into the slot returned by beginTx(), and wakes
+ * the TX ISR if it went idle.
+ *
+ * @param priority Same flag as passed to beginTx()
+ */
+void IR::endTx(uint8_t priority)
+{
+  if (priority) {
+    txPriorityQueue.push();
   } else {
-    this->currentPulseDelay = this->irConfig.shortPulseDuration;
+    txQueue.push();
   }
-
-  // Enable IR for sending the next bit
-  this->markPulse();
   
-  // Decrement the current packet position
-  --this->currentPacketBit;
+  ++txQueuedCount;
+  
+  // The ISR only disables itself when both queues are empty, which can no
+  // longer happen once the packet has been pushed
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  
+  if (!IRHal::txTimerArmed()) {
+    txEnabled = 1;
+    IRHal::txTimerArm(IR_TX_TICKS(16));
+  }
+  
+  IRHal::restoreInterrupts(oldSREG);
 }
 
 /**
- * Called by subclasses to configure a new packet to be transmitted.
- * Sets the internal packet buffer to the new packet value
- * and initializes the variables required by the handleTx() method.
+ * Last packet of the normal TX queue, if the TX ISR has not started it
+ * yet. The ISR may start it as soon as this returns, but it then sends the
+ * slot's contents as they are at that time.
+ *
+ * @return Frame waiting in the queue, or 0 if there is none
  */
-void IR::tx(uint32_t *packet)
+IRTxFrame *IR::getWaitingTx()
 {
-  if (!this->txEnabled) {
-    this->txEnabled = 1;
-    this->packetBuffer = *packet;
-    this->currentPacketBit = this->irConfig.packetBits;
-    this->startPulseSent = 0;
-    this->inPulseGap = 0;
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  IRTxFrame *frame = txQueue.last();
+  
+  if (frame == txFrame) {
+    frame = 0;
   }
+  
+  IRHal::restoreInterrupts(oldSREG);
+  
+  return frame;
 }
 
 /**
- * Enable IR LED
+ * Indicates whether a TX queue is full, in which case the next packet
+ * queued on it would be rejected.
+ *
+ * @param priority Boolean flag selecting the priority queue
  */
-void IR::irOn() { 
-  this->lastBitTime = micros();
+uint8_t IR::isTxQueueFull(uint8_t priority)
+{
+  return priority ? txPriorityQueue.isFull() : txQueue.isFull();
+}
+
+/**
+ * Number of packets queued by endTx() so far, modulo 256
+ */
+uint8_t IR::getTxQueuedCount()
+{
+  return txQueuedCount;
+}
+
+/**
+ * Reports the packets started by the TX ISR. The n-th packet queued is
+ * the n-th packet started, unless a priority packet jumped the queue.
+ *
+ * @param time Variable that will store the time (as returned by micros())
+ *             at which the last packet started
+ * @return Number of packets started so far, modulo 256
+ */
+uint8_t IR::getTxStart(uint32_t *time)
+{
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  uint8_t count = txStartCount;
+  *time = txStartTime;
+  IRHal::restoreInterrupts(oldSREG);
   
-  TCCR2A |= _BV(COM2B1);
+  return count;
 }
 
 /**
- * Disable IR LED
+ * Copies the TX statistics.
+ *
+ * @param stats Variable that will store the statistics
  */
-void IR::irOff() {
-  this->lastBitTime = micros(); 
+void IR::getTxStats(IRTxStats *stats)
+{
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  *stats = txStats;
+  IRHal::restoreInterrupts(oldSREG);
+}
+
+/**
+ * Clears the TX statistics.
+ */
+void IR::resetTxStats()
+{
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  txStats.interrupts = 0;
+  txStats.totalCycles = 0;
+  txStats.maxCycles = 0;
+  txStats.lateEdges = 0;
+  txStats.maxLateTicks = 0;
+  txStats.droppedFrames = 0;
+  IRHal::restoreInterrupts(oldSREG);
+}
 
-  TCCR2A &= ~_BV(COM2B1);
+/**
+ * Indicates whether a packet (including the idle time following it) is
+ * currently being transmitted or waiting to be.
+ */
+uint8_t IR::isTransmitting()
+{
+  return txEnabled;
 }
 
 /**
- * Activate the IR signal. This will vary based on the pulseIn type.
+ * Enable IR LED
  */
-void IR::markPulse() {
-  if (this->irConfig.pulseInType == LOW) {
-    this->irOn();
-  } else {
-    this->irOff();
-  }
+void IR::irOn() { 
+  IRHal::carrierOn();
 }
 
 /**
- * Activate the IR signal. This will vary based on the pulseIn type.
+ * Disable IR LED
  */
-void IR::markGap() {
-  if (this->irConfig.pulseInType == LOW) {
-    this->irOff();
-  } else {
-    this->irOn();
-  }
+void IR::irOff() {
+  IRHal::carrierOff();
 }
 
 /**
-  * Enables IR output.  The khz value controls the modulation frequency in kilohertz.
-  * The IR output will be on pin 3 (OC2B).
-  * This routine is designed for 36-40KHz; if you use it for other values, it's up to you
-  * to make sure it gives reasonable results.  (Watch out for overflow / underflow / rounding.)
-  * TIMER2 is used in phase-correct PWM mode, with OCR2A controlling the frequency and OCR2B
-  * controlling the duty cycle.
-  * There is no prescaling, so the output frequency is 16MHz / (2 * OCR2A)
-  * To turn the output on and off, we leave the PWM running, but connect and disconnect the output pin.
-  * A few hours staring at the ATmega documentation and this will all make sense.
-  * See Ken Shirriff's Secrets of Arduino PWM at http://arcfn.com/2009/07/secrets-of-arduino-pwm.html for details.
-  */
+ * Enables IR output. The khz value controls the modulation frequency in
+ * kilohertz; the carrier is generated by the HAL (TIMER2 PWM on pin 3 on the
+ * AVR), and started by the TX ISR for each packet. The TX timer is started
+ * with its interrupt disabled; endTx() arms it when a packet is queued.
+ *
+ * @param khz Carrier frequency in kilohertz
+ */
 void IR::enableIROut(int khz) {  
-  pinMode(TIMER_PWM_PIN, OUTPUT);
-  digitalWrite(TIMER_PWM_PIN, LOW); // When not sending PWM, we want it high
-  
-  
-  // COM2A = 00: disconnect OC2A
-  // COM2B = 00: disconnect OC2B; to send signal set to 10: OC2B non-inverted
-  // WGM2 = 101: phase-correct PWM with OCRA as top
-  // CS2 = 000: no prescaling
-  // The top value for the timer.  The modulation frequency will be SYSCLOCK / 2 / OCR2A.
-  const uint8_t pwmval = SYSCLOCK / 2000 / khz;
-  TCCR2A = _BV(WGM20);
-  TCCR2B = _BV(WGM22) | _BV(CS20);
-  OCR2A = pwmval;
-  OCR2B = pwmval / 3;
-  TIMSK2 = _BV(TOIE1);
-  
+  IRHal::carrierEnable(khz);
   this->irOff();
+  IRHal::txTimerEnable();
 }
 
 /**
- * Reads in an IR packet from the configured RX pin
- *
- * @param packet Variable that will store the packet
- * @param timeout Maximum execution time of this routine
- * @return Boolean indicating whether a packet was received
+ * Enables interrupt-driven IR input. A pin change interrupt is attached to the
+ * RX pin; every transition is timestamped with the TX timer and the resulting
+ * pulse is stored in the pulse buffer, where it waits to be decoded by poll().
+ */
+void IR::enableIRIn() {
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  
+  rxInstance = this;
+  IRHal::txTimerEnable();
+  IRHal::rxEnable(this->rxPin);
+  
+  rxLevel = IRHal::rxRead();
+  rxEdgeTicks = IRHal::txTimerCount();
+  rxSaturated = 0;
+  IRHal::rxTimeoutArm(rxEdgeTicks + IR_RX_TIMEOUT_TICKS);
+  
+  IRHal::restoreInterrupts(oldSREG);
+}
+
+/**
+ * Method called by the pin change Interrupt Service Routines. Measures the
+ * pulse that just ended on the RX pin and appends it to the pulse buffer.
+ * The pulse is timed with the TX timer rather than micros(), which takes
+ * long enough to make a TX compare match due meanwhile late.
  */
-uint8_t IR::rx(uint32_t *packet, uint32_t timeout)
+void IR::handleRxEdge()
 {
-  uint32_t startTimeMillis = millis();
-  uint32_t lastPulseMillis = millis();
-  uint32_t packetMask = (1UL << this->irConfig.packetBits) - 1;
-  uint8_t currentPacketBits = 0;
-  *packet = 0;
-  
-  if (this->irConfig.startPulseDuration) {
-    // Wait for the start pulse before reading in the rest of the packet.
-    while (timeout == 0 || millis() - startTimeMillis < timeout) {
-      uint32_t pulse = readPulse(this->rxPin, this->irConfig.pulseInType, this->irConfig.startPulseDuration + this->irConfig.pulseTolerance);
-      if (pulse > this->irConfig.startPulseDuration - 300
-          && pulse < this->irConfig.startPulseDuration + 300) {
-        break;
-      }
-    }
+  uint8_t level = IRHal::rxRead();
+  
+  // Pin change interrupts fire for every enabled pin on the port, so
+  // ignore changes that did not affect the RX pin
+  if (level == rxLevel) {
+    return;
   }
   
-  // Loop until the packet passes the IR configuration's checksum, we've
-  // retrieved the correct amount of packet bits, and we have not
-  // timed out.
-  while(
-    (!this->irConfig.hasChecksum || !this->checksum(packet))
-      && (this->irConfig.packetBits == 0 || this->irConfig.packetBits != currentPacketBits) 
-      && (timeout == 0 || millis() - startTimeMillis < timeout)) {
-      
-    // Read in the next pulse from the RX pin. This returns the number of microseconds that 
-    // pass between two peaks or two valleys on the RX pin, depending on the configured
-    // Pulse In type
-    uint32_t pulse = readPulse(
-      this->rxPin, 
-      this->irConfig.pulseInType, 
-      2 * this->irConfig.longPulseDuration
-    );
-
-    // If the current pulse length falls within the tolerance for the short pulse,
-    // we append a '0' to the current packet.
-    if (pulse > this->irConfig.shortPulseDuration - this->irConfig.pulseTolerance 
-      && pulse < this->irConfig.shortPulseDuration + this->irConfig.pulseTolerance) {
-      *packet = (*packet << 1) & packetMask;
-      currentPacketBits++;
-    }
-    // If the current pulse length falls within the tolerance for the long pulse,
-    // we append a '1' to the current packet.
-    else if (pulse > this->irConfig.longPulseDuration - this->irConfig.pulseTolerance
-      && pulse < this->irConfig.longPulseDuration + this->irConfig.pulseTolerance) {
-      *packet = ((*packet << 1) | 1) & packetMask;
-      currentPacketBits++;
+  uint16_t now = IRHal::txTimerCount();
+  
+  // A saturated pulse was stored by the timeout already. A timeout that
+  // has not been handled yet means the counter may have wrapped around
+  // since the previous edge.
+  if (!rxSaturated) {
+    uint16_t width = IR_PULSE_WIDTH;
+    
+    if (!IRHal::rxTimeoutPending()) {
+      width = (uint16_t)(now - rxEdgeTicks) / IR_TX_TICKS_PER_US;
     }
     
-    lastPulseMillis = millis();
+    // The pulse that just ended was at the previous level of the pin
+    pulseBuffer.push((rxLevel == HIGH ? IR_PULSE_LEVEL : 0) | width);
   }
   
-  // If the packet passes the checksum (if defined) and the length of the packet matches
-  // the defined packet length, return TRUE
-  if ((!this->irConfig.hasChecksum || this->checksum(packet))
-      && (!this->irConfig.packetBits || currentPacketBits == this->irConfig.packetBits)) {
-    return 1;
-  }
+  rxLevel = level;
+  rxEdgeTicks = now;
+  rxSaturated = 0;
+  IRHal::rxTimeoutArm(now + IR_RX_TIMEOUT_TICKS);
+  ++rxEdgeCount;
+}
 
-  return 0;
+/**
+ * Method called by the RX timeout Interrupt Service Routine, once the RX pin
+ * has kept its level for IR_RX_TIMEOUT_TICKS. The pulse is saturated from
+ * then on, so it is stored right away: an idle gap then ends the packet
+ * before it reaches the decoders, without waiting for the next edge.
+ */
+void IR::handleRxTimeout()
+{
+  pulseBuffer.push((rxLevel == HIGH ? IR_PULSE_LEVEL : 0) | IR_PULSE_WIDTH);
+  
+  rxSaturated = 1;
+  IRHal::rxTimeoutDisarm();
 }
 
 /**
- * The built-in pulseIn() routine does not return correct timings, perhaps because it relies
- * on clock cycles. This method utilizes timer readings instead, so is less prone to error
- * introduced by interrupts.
- * @author DaveMAA (http://arduino.cc/forum/index.php/topic,25816.msg193479.html#msg193479)
+ * Number of RX edges captured so far, modulo 256
  */
-uint32_t IR::readPulse(uint16_t pin, uint16_t signal, uint32_t timeout){
-  uint32_t current, killTime, ptime;
-  current = micros();
-  killTime = current + timeout;
-  
-  while (digitalRead(pin) == signal) {
-    delayMicroseconds(4); 
-    current = micros();
-    if(current >= killTime){
-      return 0UL;
-    }
+uint8_t IR::getRxEdgeCount()
+{
+  return rxEdgeCount;
+}
+
+/**
+ * Number of TX ISR invocations so far, modulo 256
+ */
+uint8_t IR::getTxEdgeCount()
+{
+  return txEdgeCount;
+}
+
+/**
+ * Retrieves the oldest captured pulse without blocking.
+ *
+ * @param pulse Variable that will store the pulse level and width
+ * @return Boolean indicating whether a pulse was available
+ */
+uint8_t IR::readPulse(uint16_t *pulse)
+{
+  if (!pulseBuffer.pop(pulse)) {
+    return 0;
   }
   
-  while(digitalRead(pin) != signal){
-    delayMicroseconds(4);
-    current = micros(); 
-    if(current >= killTime){
-      return 0UL;
-    }
+  if (this->pulseTap) {
+    this->pulseTap(*pulse);
   }
   
-  ptime = micros();
-  while (digitalRead(pin) == signal) {
-    delayMicroseconds(4); 
+  return 1;
+}
+
+/**
+ * Registers a function called with every pulse returned by readPulse(), e.g.
+ * to record the pulses as they are decoded.
+ *
+ * @param tap Function to call, or 0 to stop
+ */
+void IR::setPulseTap(IRPulseTap tap)
+{
+  this->pulseTap = tap;
+}
+
+/**
+ * Time at which the pulse last returned by readPulse() ended, as returned by
+ * micros(). Derived from the time elapsed since the last pulse was stored
+ * and the pulses still buffered. A saturated pulse was stored when it timed
+ * out, and the time since is only measured within one TX timer period.
+ */
+uint32_t IR::getPulseEndTime()
+{
+  uint8_t oldSREG = IRHal::disableInterrupts();
+  uint16_t ticks = IRHal::txTimerCount() - rxEdgeTicks;
+  uint16_t elapsed = IR_PULSE_WIDTH;
+  
+  if (rxSaturated) {
+    elapsed = (uint16_t)(ticks - IR_RX_TIMEOUT_TICKS) / IR_TX_TICKS_PER_US;
+  } else if (!IRHal::rxTimeoutPending()) {
+    elapsed = ticks / IR_TX_TICKS_PER_US;
   }
-  return micros() - ptime;
+  
+  uint32_t time = micros() - elapsed - pulseBuffer.pendingWidth();
+  IRHal::restoreInterrupts(oldSREG);
+  
+  return time;
 }
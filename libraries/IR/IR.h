@@ -14,102 +14,283 @@
  */ 
 #ifndef _IR_H_
 #define _IR_H_
-#include <WProgram.h>
-#include <Arduino.h>
 #include <inttypes.h>
+#include "IRHal.h"
+#include "IRFrameQueue.h"
 
 /**
- * Configuration object for the IR transmitter / receiver.
- */
-struct IRConfig {   
-  /**
-   * Duration of the start pulse. Not used in every protocol. Set
-   * to 0 if unused.
-   */
-  uint16_t startPulseDuration;
-  
-  /**
-   * Duration of the pulse used to signify a low bit. 
-   */
-  uint16_t shortPulseDuration;
-  
-  /**
-   * Duration of the pulse used to signify a high bit.
-   */
-  uint16_t longPulseDuration;
-  
-  /**
-   * Duration of the gap between each pulse
-   */
-  uint16_t pulseGapDuration;
-  
-  /**
-   * Idle time between packet reception.
-   */
-  uint32_t gapDuration;
-  
-  /**
-   * Error tolerance allowed when measuring a pulse width.
-   */
-  uint16_t pulseTolerance;
- 
-  /**
-   * Type to use for reading pulses (either HIGH or LOW)
-   */
-  uint8_t pulseInType;
-  
-  /**
-   * Frequency of the IR transmission
-   */
-  uint8_t txFrequency;
-  
-  /**
-   * Number of bits in the IR packet. Cannot exceed 32.
-   */
-  uint8_t  packetBits;
-
-  /**
-   * If true, IR packet has a valid checksum routine
-   */
-  uint8_t hasChecksum;
+ * Number of pulses held by the RX pulse buffer. Must be a power of two.
+ */
+#ifndef IR_PULSE_BUFFER_SIZE
+#define IR_PULSE_BUFFER_SIZE 64
+#endif
+
+/**
+ * Each captured pulse is stored as a 16-bit value: the top bit holds the
+ * level of the RX pin during the pulse, the remaining bits hold its width
+ * in microseconds (saturated at IR_PULSE_WIDTH).
+ */
+#define IR_PULSE_LEVEL 0x8000
+#define IR_PULSE_WIDTH 0x7FFF
+
+/**
+ * Packets are stored as arrays of 32-bit words, first bit first: every word
+ * but the last holds 32 bits, most significant bit first, and the last
+ * word holds the remaining bits right-aligned. A packet of up to 32 bits is
+ * thus a single word holding the packet as is.
+ */
+#define IR_PACKET_WORDS(bits) (((bits) + 31) / 32)
+
+/**
+ * Longest packet that can be queued for transmission or received through
+ * an IRMultiDecoder. Longer protocols can still be decoded on their own.
+ */
+#ifndef IR_MAX_PACKET_BITS
+#define IR_MAX_PACKET_BITS 32
+#endif
+
+/**
+ * Number of packets that can wait for transmission. Must be a power of two.
+ */
+#ifndef IR_TX_QUEUE_SIZE
+#define IR_TX_QUEUE_SIZE 2
+#endif
+
+/**
+ * Each TX edge is stored as a 16-bit value: the top bit holds the
+ * level of the IR LED, the remaining bits hold the edge's duration in TX
+ * ticks (at most IR_MAX_EDGE_TICKS).
+ */
+#define IR_EDGE_LEVEL 0x8000
+#define IR_MAX_EDGE_TICKS 0x7FFF
+
+/**
+ * TX edges are timed by a free-running timer (TIMER1 at SYSCLOCK / 8 on
+ * the AVR), so one TX tick lasts 0.5us.
+ */
+#define IR_TX_TICKS_PER_US 2
+#define IR_TX_TICKS(us) ((uint32_t)(us) * IR_TX_TICKS_PER_US)
+#define IR_TX_CYCLES_PER_TICK 8
+
+/**
+ * RX pulses are timed by the same timer. A pulse still running after this
+ * many TX ticks is saturated at IR_PULSE_WIDTH, before the 16-bit counter
+ * wraps around.
+ */
+#define IR_RX_TIMEOUT_TICKS IR_TX_TICKS(IR_PULSE_WIDTH)
+
+/**
+ * An edge switched more than this many TX ticks after its scheduled time
+ * is counted as late by the TX statistics.
+ */
+#ifndef IR_TX_LATE_TICKS
+#define IR_TX_LATE_TICKS IR_TX_TICKS(8)
+#endif
+
+/**
+ * Fixed-size ring buffer of pulses captured by the RX pin change interrupt.
+ * The ISR is the only writer of 'head' and 'overflow', the main loop is the
+ * only writer of 'tail', so no locking is required.
+ */
+class IRPulseBuffer {
+  public:
+    IRPulseBuffer() : head(0), tail(0), overflow(0) {}
+    
+    /**
+     * Appends a pulse to the buffer. Called from the RX ISR. If the buffer
+     * is full the pulse is dropped and the overflow flag is raised. Once
+     * there is room for it and the next pulse, a saturated pulse is stored
+     * in place of the dropped ones, so decoders drop the partial packet
+     * exactly where pulses went missing.
+     */
+    inline void push(uint16_t pulse) {
+      uint8_t next = (this->head + 1) & (IR_PULSE_BUFFER_SIZE - 1);
+      
+      if (this->overflow) {
+        uint8_t after = (next + 1) & (IR_PULSE_BUFFER_SIZE - 1);
+        
+        if (next == this->tail || after == this->tail) {
+          return;
+        }
+        
+        this->buffer[this->head] = IR_PULSE_WIDTH;
+        this->head = next;
+        this->overflow = 0;
+        next = after;
+      } else if (next == this->tail) {
+        this->overflow = 1;
+        return;
+      }
+      
+      this->buffer[this->head] = pulse;
+      this->head = next;
+    }
+    
+    /**
+     * Removes the oldest pulse from the buffer.
+     *
+     * @return Boolean indicating whether a pulse was available
+     */
+    inline uint8_t pop(uint16_t *pulse) {
+      if (this->tail == this->head) {
+        return 0;
+      }
+      
+      *pulse = this->buffer[this->tail];
+      this->tail = (this->tail + 1) & (IR_PULSE_BUFFER_SIZE - 1);
+      return 1;
+    }
+    
+    /**
+     * Total width of the pulses waiting in the buffer, in microseconds.
+     * Must be called with interrupts disabled.
+     */
+    uint32_t pendingWidth() {
+      uint32_t width = 0;
+      
+      for (uint8_t i = this->tail; i != this->head; i = (i + 1) & (IR_PULSE_BUFFER_SIZE - 1)) {
+        width += this->buffer[i] & IR_PULSE_WIDTH;
+      }
+      
+      return width;
+    }
+    
+  private:
+    volatile uint16_t buffer[IR_PULSE_BUFFER_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile uint8_t overflow;
+};
+
+/**
+ * Single step of a TX packet: the IR LED is switched on (with IR_EDGE_LEVEL)
+ * or off for the given number of TX ticks (TIMER1 counts).
+ */
+typedef uint16_t IREdge;
+
+/**
+ * Timings of a protocol's TX packets, compiled once per protocol (see
+ * IRProtocol::txTimings). A packet is sent as a gap and the start pulse
+ * (if startEdge is not 0), a gap and a pulse per bit, a trailing gap, then
+ * idleTicks of idle time.
+ */
+struct IRTxTimings {
+  uint32_t idleTicks;
+  uint32_t lastMask;     // Mask of the first bit in the packet's last word
+  uint8_t bits;
+  IREdge startEdge;
+  IREdge gapEdge;
+  IREdge shortEdge;
+  IREdge longEdge;
+};
+
+/**
+ * Packet waiting in the TX queue. The TX ISR walks its bits, generating
+ * each edge from the protocol's timings when it is due.
+ */
+struct IRTxFrame {
+  uint32_t words[IR_PACKET_WORDS(IR_MAX_PACKET_BITS)];
+  const IRTxTimings *timings;
+};
+
+/**
+ * Counters kept by the TX path. Cycle counts have the resolution of one
+ * TX tick (IR_TX_CYCLES_PER_TICK cycles), and cover the handler called by
+ * the interrupt vector, not the vector's register save and restore.
+ */
+struct IRTxStats {
+  uint32_t interrupts;     // TX ISR invocations
+  uint32_t totalCycles;    // Cycles spent in the TX ISR
+  uint16_t maxCycles;      // Longest TX ISR invocation
+  uint16_t lateEdges;      // Edges switched over IR_TX_LATE_TICKS late
+  uint16_t maxLateTicks;   // Latest edge, in TX ticks past its schedule
+  uint16_t droppedFrames;  // Packets rejected as the TX queue was full
 };
 
+/**
+ * Function called with every pulse returned by IR::readPulse()
+ */
+typedef void (*IRPulseTap)(uint16_t);
+
+/**
+ * The IR class holds the protocol-independent machinery: the RX pulse
+ * capture, and the playback of queued TX packets. Protocol-specific
+ * decoding and encoding live in the IRProtocol template (see IRProtocol.h).
+ *
+ * There is a single receiver and a single transmitter on the board, so
+ * their state is static and an instance only holds its configuration. The
+ * constructor does not touch the hardware: instances can be allocated
+ * statically, and are started by begin() from setup().
+ */
 class IR {
   public:
     IR(uint8_t, uint8_t);
-    uint8_t rx(uint32_t *, uint32_t);
+    void begin();
+    uint8_t readPulse(uint16_t *);
+    void setPulseTap(IRPulseTap);
+    uint32_t getPulseEndTime();
+    uint8_t isTransmitting();
+    uint8_t isTxQueueFull(uint8_t = 0);
+    uint8_t getTxQueuedCount();
+    uint8_t getTxStart(uint32_t *);
+    void getTxStats(IRTxStats *);
+    void resetTxStats();
     
     void handleTx();
+    void handleRxEdge();
+    void handleRxTimeout();
+    
+    static void handleTxInterrupt();
+    static void handleRxInterrupt();
+    static void handleRxTimeoutInterrupt();
+    
+    static uint8_t getRxEdgeCount();
+    static uint8_t getTxEdgeCount();
     
     void irOn();
     void irOff();
-    void markPulse();
-    void markGap();
     
   private:
     uint8_t rxPin;
-    uint32_t packetBuffer;
-    
-    volatile uint8_t initialized;
-    volatile uint8_t txEnabled;
-    volatile uint8_t currentPacketBit;
-    volatile uint8_t inPulseGap;
-    volatile uint8_t startPulseSent;
-    volatile uint16_t currentPulseDelay;
-    volatile uint32_t lastBitTime;
-    volatile uint32_t lastPacketTime;
-    
-    void sendPulse(uint32_t);
+    IRPulseTap pulseTap;
+    
+    static volatile uint8_t rxLevel;
+    static volatile uint16_t rxEdgeTicks;
+    static volatile uint8_t rxSaturated;
+    static volatile uint8_t rxEdgeCount;
+    static volatile uint8_t txEdgeCount;
+    
+    static IRTxFrame *txFrame;
+    static uint8_t txFromPriority;
+    static uint8_t txPhase;
+    static const uint32_t *txWord;
+    static uint32_t txMask;
+    static uint8_t txBitsLeft;
+    static uint32_t txIdleTicks;
+    
+    static uint8_t txQueuedCount;
+    static volatile uint8_t txStartCount;
+    static volatile uint32_t txStartTime;
+    
+    static IRTxStats txStats;
+    
+    IREdge nextTxEdge();
+    void countTx(uint16_t);
+    
   protected:
-    IRConfig irConfig;
+    static IRFrameQueue<IRTxFrame, IR_TX_QUEUE_SIZE> txQueue;
+    static IRFrameQueue<IRTxFrame, 1> txPriorityQueue;
+    
+    static volatile uint8_t txEnabled;
     
-    void tx(uint32_t *);
-    virtual uint8_t checksum(uint32_t *) = 0;
-    virtual void sendPacket() = 0;
+    uint8_t txCapable;
     
+    IRTxFrame *beginTx(uint8_t);
+    void endTx(uint8_t);
+    IRTxFrame *getWaitingTx();
     
     void enableIROut(int);
-    uint32_t readPulse(uint16_t, uint16_t, uint32_t);
+    void enableIRIn();
 };
 
 #endif
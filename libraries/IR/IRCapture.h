@@ -0,0 +1,128 @@
+/**
+ * IR Capture
+ *
+ * This library defines a compact binary format for streams of captured RX
+ * pulses, so raw receiver traffic can be recorded over serial and replayed
+ * through the decoders.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_CAPTURE_H_
+#define _IR_CAPTURE_H_
+
+#include "IR.h"
+
+/**
+ * A capture starts with the magic bytes and the version, followed by one
+ * record per pulse. A pulse is the time between two edges, so the stream
+ * is delta-encoded by nature: each record is the value
+ * (width << 1) | level, where level is 1 for a HIGH pulse, written 7 bits
+ * at a time, least significant first, with the top bit of each byte set
+ * when another byte follows (LEB128). Typical pulses take 2 bytes.
+ */
+#define IR_CAPTURE_MAGIC        "IRCP"
+#define IR_CAPTURE_MAGIC_SIZE   4
+#define IR_CAPTURE_VERSION      1
+#define IR_CAPTURE_HEADER_SIZE  (IR_CAPTURE_MAGIC_SIZE + 1)
+
+/**
+ * Longest record, in bytes
+ */
+#define IR_CAPTURE_MAX_RECORD 3
+
+class IRCapture {
+  public:
+    /**
+     * Writes the header of a capture.
+     *
+     * @param out Stream to write to (e.g. Serial)
+     */
+    template <class Output>
+    static void writeHeader(Output &out) {
+      const char *magic = IR_CAPTURE_MAGIC;
+      
+      while (*magic) {
+        out.write((uint8_t)*magic++);
+      }
+      
+      out.write((uint8_t)IR_CAPTURE_VERSION);
+    }
+    
+    /**
+     * Checks the header of a capture.
+     *
+     * @param data Start of the capture
+     * @param size Size of the capture in bytes
+     * @return Boolean indicating whether the header is valid
+     */
+    static uint8_t checkHeader(const uint8_t *data, uint32_t size) {
+      const char *magic = IR_CAPTURE_MAGIC;
+      
+      if (size < IR_CAPTURE_HEADER_SIZE) {
+        return 0;
+      }
+      
+      for (uint8_t i = 0; i < IR_CAPTURE_MAGIC_SIZE; ++i) {
+        if (data[i] != (uint8_t)magic[i]) {
+          return 0;
+        }
+      }
+      
+      return data[IR_CAPTURE_MAGIC_SIZE] == IR_CAPTURE_VERSION;
+    }
+    
+    /**
+     * Encodes a pulse.
+     *
+     * @param pulse Captured pulse (level and width)
+     * @param record Output buffer of IR_CAPTURE_MAX_RECORD bytes
+     * @return Size of the record in bytes
+     */
+    static inline uint8_t encode(uint16_t pulse, uint8_t *record) {
+      uint32_t value = ((uint32_t)(pulse & IR_PULSE_WIDTH) << 1) | ((pulse & IR_PULSE_LEVEL) ? 1 : 0);
+      uint8_t size = 0;
+      
+      while (value > 0x7F) {
+        record[size++] = (uint8_t)value | 0x80;
+        value >>= 7;
+      }
+      
+      record[size++] = (uint8_t)value;
+      return size;
+    }
+    
+    /**
+     * Decodes the next pulse of a capture.
+     *
+     * @param data Position in the capture, advanced past the record
+     * @param end End of the capture
+     * @param pulse Variable that will store the pulse
+     * @return Boolean indicating whether a complete record was read
+     */
+    static inline uint8_t decode(const uint8_t **data, const uint8_t *end, uint16_t *pulse) {
+      const uint8_t *p = *data;
+      uint32_t value = 0;
+      
+      for (uint8_t shift = 0; p < end && shift < 7 * IR_CAPTURE_MAX_RECORD; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        
+        if (!(byte & 0x80)) {
+          *data = p;
+          *pulse = ((value & 1) ? IR_PULSE_LEVEL : 0) | ((value >> 1) & IR_PULSE_WIDTH);
+          return 1;
+        }
+      }
+      
+      return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,535 @@
+/**
+ * IR Decoder
+ *
+ * This library turns a stream of captured pulses into IR packets.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_DECODER_H_
+#define _IR_DECODER_H_
+
+#include "IR.h"
+#include "IRPulseClassifier.h"
+
+/**
+ * Pulse width tracking (see IRProtocolDecoder). Each valid packet moves the
+ * tracked widths 1/2^IR_TRACKING_SHIFT of the way to the widths measured
+ * in the packet. The decoder locks after IR_TRACKING_LOCK_FRAMES valid
+ * packets, and unlocks once as many more packets were broken than valid.
+ */
+#ifndef IR_TRACKING_SHIFT
+#define IR_TRACKING_SHIFT 3
+#endif
+
+#ifndef IR_TRACKING_LOCK_FRAMES
+#define IR_TRACKING_LOCK_FRAMES 4
+#endif
+
+/**
+ * Interface implemented by every protocol decoder. A decoder is fed one
+ * captured pulse at a time (in the format stored by IRPulseBuffer) and
+ * keeps its own state between pulses, so several decoders can share one
+ * pulse stream.
+ */
+class IRDecoder {
+  public:
+    virtual uint8_t decode(uint16_t, uint32_t *) = 0;
+    virtual void reset() = 0;
+    virtual uint8_t getPacketBits() = 0;
+};
+
+/**
+ * Words of a packet longer than 32 bits already received by a decoder, all
+ * but the last (see IR_PACKET_WORDS). Empty for packets of up to 32 bits.
+ */
+template <uint8_t Words>
+class IRDecoderWords {
+  protected:
+    inline uint32_t getWord(uint8_t i) { return this->rxWords[i]; }
+    inline void setWord(uint8_t i, uint32_t word) { this->rxWords[i] = word; }
+    
+  private:
+    uint32_t rxWords[Words];
+};
+
+template <>
+class IRDecoderWords<0> {
+  protected:
+    inline uint32_t getWord(uint8_t) { return 0; }
+    inline void setWord(uint8_t, uint32_t) {}
+};
+
+/**
+ * Decoder for the protocol described by a traits class (see IRProtocol.h).
+ * Pulses are classified through a lookup table built from the protocol's
+ * timings; everything else is a compile-time constant.
+ *
+ * Bits are shifted into a single 32-bit word. In packets longer than 32
+ * bits, each word is stored once full, so a bit never costs more than one
+ * single-word shift.
+ *
+ * Packets are framed by their start pulse (if the protocol has one) and by
+ * the idle gaps around them. A packet whose start pulse was lost or
+ * distorted is still accepted, once the gap following it shows it held
+ * exactly packetBits bits since the previous gap. The IR class delivers
+ * that gap as a saturated pulse as soon as it times out, without waiting
+ * for the next packet's first edge.
+ *
+ * If the protocol defines a signature, the packet is checked against it
+ * bit by bit as it shifts in, and dropped on the first bit that cannot
+ * match. Without a start pulse, the decoder then slides (as it does when
+ * the checksum fails) to the longest run of trailing bits that still
+ * matches the start of the signature, so a packet right after noise is
+ * not lost.
+ *
+ * If the protocol sets a trackingTolerance, the decoder follows the drift
+ * of the remote's oscillator: the start, short and long pulse widths are
+ * estimated from the valid packets, within pulseTolerance of their nominal
+ * values, and the table is rebuilt around the estimates. Once locked, the
+ * windows narrow from pulseTolerance to trackingTolerance.
+ */
+template <class Protocol>
+class IRProtocolDecoder
+  : public IRDecoder,
+    protected IRDecoderWords<IR_PACKET_WORDS(Protocol::packetBits) - 1> {
+  public:
+    IRProtocolDecoder();
+    
+    virtual uint8_t decode(uint16_t, uint32_t *);
+    virtual void reset();
+    virtual uint8_t getPacketBits();
+    
+    uint16_t getPulseWidth(uint8_t);
+    uint8_t isLocked();
+    
+  protected:
+    static const uint16_t maxDrift = Protocol::trackingTolerance ? Protocol::pulseTolerance : 0;
+    static const uint16_t longestPulse = (Protocol::startPulseDuration > Protocol::longPulseDuration
+      ? Protocol::startPulseDuration : Protocol::longPulseDuration) + Protocol::pulseTolerance + maxDrift;
+    static const uint8_t packetWords = IR_PACKET_WORDS(Protocol::packetBits);
+    static const uint32_t packetMask = (Protocol::packetBits < 32) 
+      ? (1UL << (Protocol::packetBits & 31)) - 1 : 0xFFFFFFFFUL;
+    
+    static_assert(IR_CLASSIFIER_BUCKETS(longestPulse) <= 255,
+                  "Pulses too long for the classifier: raise IR_CLASSIFIER_SHIFT");
+    
+    IRPulseTable<IR_CLASSIFIER_BUCKETS(longestPulse)> classifier;
+    
+    uint32_t rxPacket;
+    uint8_t rxPacketBits;
+    uint8_t rxStarted;
+    uint8_t rxSynced;
+    
+    // Tracked widths and the widths measured in the current packet, indexed
+    // by symbol (IR_SYMBOL_ZERO, IR_SYMBOL_ONE, IR_SYMBOL_START)
+    uint16_t pulseWidths[IR_SYMBOL_START + 1];
+    uint32_t frameWidths[IR_SYMBOL_START + 1];
+    uint8_t frameCounts[IR_SYMBOL_START + 1];
+    uint8_t lockCount;
+    uint8_t locked;
+    
+    void build();
+    void clearWidths();
+    uint8_t matches(uint8_t);
+    void realign();
+    void nextWord();
+    uint8_t complete(uint32_t *);
+    uint8_t endFrame(uint32_t *);
+    void measure(uint8_t, uint16_t);
+    void track();
+    void miss();
+    
+    static uint16_t nominalWidth(uint8_t);
+};
+
+/**
+ * Construct a decoder, building its pulse classification table from the
+ * protocol's timings.
+ */
+template <class Protocol>
+IRProtocolDecoder<Protocol>::IRProtocolDecoder()
+  : rxPacket(0),
+    rxPacketBits(0),
+    rxStarted(0),
+    rxSynced(0),
+    lockCount(0),
+    locked(0)
+{
+  for (uint8_t symbol = IR_SYMBOL_ZERO; symbol <= IR_SYMBOL_START; ++symbol) {
+    this->pulseWidths[symbol] = nominalWidth(symbol);
+    this->frameWidths[symbol] = 0;
+    this->frameCounts[symbol] = 0;
+  }
+  
+  this->build();
+}
+
+/**
+ * Nominal width of a symbol's pulse, in microseconds
+ */
+template <class Protocol>
+uint16_t IRProtocolDecoder<Protocol>::nominalWidth(uint8_t symbol)
+{
+  if (symbol == IR_SYMBOL_ZERO) {
+    return Protocol::shortPulseDuration;
+  } else if (symbol == IR_SYMBOL_ONE) {
+    return Protocol::longPulseDuration;
+  }
+  
+  return Protocol::startPulseDuration;
+}
+
+/**
+ * Rebuilds the classification table around the tracked widths.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::build()
+{
+  this->classifier.build(
+    this->pulseWidths[IR_SYMBOL_START],
+    this->pulseWidths[IR_SYMBOL_ZERO],
+    this->pulseWidths[IR_SYMBOL_ONE],
+    this->locked ? Protocol::trackingTolerance : Protocol::pulseTolerance
+  );
+}
+
+/**
+ * Drops any partial packet. Until the next start pulse or idle gap, the
+ * decoder does not know where packets begin.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::reset()
+{
+  this->rxPacket = 0;
+  this->rxPacketBits = 0;
+  this->rxStarted = 0;
+  this->rxSynced = 0;
+  this->clearWidths();
+}
+
+/**
+ * Drops the widths measured in the current packet.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::clearWidths()
+{
+  if (Protocol::trackingTolerance) {
+    for (uint8_t symbol = IR_SYMBOL_ZERO; symbol <= IR_SYMBOL_START; ++symbol) {
+      this->frameWidths[symbol] = 0;
+      this->frameCounts[symbol] = 0;
+    }
+  }
+}
+
+/**
+ * Checks the last bits received against the start of the signature. Bits
+ * past the signature always match.
+ *
+ * @param bits Number of bits received in the packet
+ * @return Boolean indicating whether the packet can still match
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::matches(uint8_t bits)
+{
+  if (bits >= Protocol::signatureBits) {
+    return 1;
+  }
+  
+  return (this->rxPacket & ((1UL << bits) - 1)) == (Protocol::signature >> (Protocol::signatureBits - bits));
+}
+
+/**
+ * Restarts a packet that no longer matches the signature from the longest
+ * run of trailing bits that does, as the packet may have begun within the
+ * bits already received. The widths measured so far are dropped.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::realign()
+{
+  uint8_t bits = this->rxPacketBits;
+  
+  while (bits && !this->matches(bits)) {
+    --bits;
+  }
+  
+  this->rxPacketBits = bits;
+  this->clearWidths();
+}
+
+/**
+ * Length of the packets returned by decode(), in bits
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::getPacketBits()
+{
+  return Protocol::packetBits;
+}
+
+/**
+ * Stores the word just filled by the last bit received, if the packet goes
+ * on past it.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::nextWord()
+{
+  if (packetWords > 1 && !(this->rxPacketBits & 31) && this->rxPacketBits < Protocol::packetBits) {
+    this->setWord((this->rxPacketBits >> 5) - 1, this->rxPacket);
+    this->rxPacket = 0;
+  }
+}
+
+/**
+ * Adds a classified pulse to the widths measured in the current packet.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::measure(uint8_t symbol, uint16_t width)
+{
+  if (Protocol::trackingTolerance) {
+    this->frameWidths[symbol] += width;
+    ++this->frameCounts[symbol];
+  }
+}
+
+/**
+ * Moves the tracked widths towards the widths measured in the packet just
+ * accepted, and locks the decoder once enough packets were accepted. The
+ * table is only rebuilt when a window moves by at least a bucket.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::track()
+{
+  if (!Protocol::trackingTolerance) {
+    return;
+  }
+  
+  uint8_t rebuild = 0;
+  
+  for (uint8_t symbol = IR_SYMBOL_ZERO; symbol <= IR_SYMBOL_START; ++symbol) {
+    if (!this->frameCounts[symbol]) {
+      continue;
+    }
+    
+    int32_t nominal = nominalWidth(symbol);
+    int32_t current = this->pulseWidths[symbol];
+    int32_t measured = this->frameWidths[symbol] / this->frameCounts[symbol];
+    int32_t width = current + (measured - current) / (1 << IR_TRACKING_SHIFT);
+    
+    if (width < nominal - Protocol::pulseTolerance) {
+      width = nominal - Protocol::pulseTolerance;
+    } else if (width > nominal + Protocol::pulseTolerance) {
+      width = nominal + Protocol::pulseTolerance;
+    }
+    
+    if ((width >> IR_CLASSIFIER_SHIFT) != (current >> IR_CLASSIFIER_SHIFT)) {
+      rebuild = 1;
+    }
+    
+    this->pulseWidths[symbol] = width;
+  }
+  
+  if (this->lockCount < IR_TRACKING_LOCK_FRAMES && ++this->lockCount == IR_TRACKING_LOCK_FRAMES) {
+    rebuild |= !this->locked;
+    this->locked = 1;
+  }
+  
+  if (rebuild) {
+    this->build();
+  }
+}
+
+/**
+ * Counts a packet broken by a pulse outside every window. The decoder
+ * unlocks, widening its windows again, once it has missed as many packets
+ * as it accepted since locking.
+ */
+template <class Protocol>
+void IRProtocolDecoder<Protocol>::miss()
+{
+  if (!Protocol::trackingTolerance || !this->lockCount) {
+    return;
+  }
+  
+  if (--this->lockCount == 0 && this->locked) {
+    this->locked = 0;
+    this->build();
+  }
+}
+
+/**
+ * Tracked width of a symbol's pulse
+ *
+ * @param symbol IR_SYMBOL_ZERO, IR_SYMBOL_ONE or IR_SYMBOL_START
+ * @return Width in microseconds
+ */
+template <class Protocol>
+uint16_t IRProtocolDecoder<Protocol>::getPulseWidth(uint8_t symbol)
+{
+  return this->pulseWidths[symbol];
+}
+
+/**
+ * Indicates whether the decoder narrowed its windows to trackingTolerance
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::isLocked()
+{
+  return this->locked;
+}
+
+/**
+ * Checks the packet just completed against the checksum (if defined).
+ *
+ * @param packet Variable that will store the packet
+ * @return Boolean indicating whether the packet is valid
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::complete(uint32_t *packet)
+{
+  uint32_t received[packetWords];
+  
+  for (uint8_t i = 0; i + 1 < packetWords; ++i) {
+    received[i] = this->getWord(i);
+  }
+  received[packetWords - 1] = this->rxPacket;
+  
+  uint8_t valid = !Protocol::hasChecksum || Protocol::checksum(received);
+  
+  if (valid) {
+    this->track();
+    
+    for (uint8_t i = 0; i < packetWords; ++i) {
+      packet[i] = received[i];
+    }
+  }
+  
+  return valid;
+}
+
+/**
+ * Handles an idle gap, which ends any packet. A packet whose start pulse
+ * was not seen is accepted here, if exactly packetBits bits were received
+ * since the previous gap.
+ *
+ * @param packet Variable that will store the packet
+ * @return Boolean indicating whether the gap completed a valid packet
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::endFrame(uint32_t *packet)
+{
+  uint8_t valid = 0;
+  
+  if (Protocol::startPulseDuration && this->rxSynced && !this->rxStarted
+      && this->rxPacketBits == Protocol::packetBits) {
+    valid = this->complete(packet);
+  }
+  
+  this->reset();
+  this->rxSynced = 1;
+  
+  return valid;
+}
+
+/**
+ * Decodes a single pulse.
+ *
+ * @param pulse Captured pulse (level and width)
+ * @param packet Variable that will store the packet
+ * @return Boolean indicating whether the pulse completed a valid packet
+ */
+template <class Protocol>
+uint8_t IRProtocolDecoder<Protocol>::decode(uint16_t pulse, uint32_t *packet)
+{
+  uint16_t width = pulse & IR_PULSE_WIDTH;
+  uint8_t symbol = this->classifier.classify(width);
+  
+  // Only pulses of the configured Pulse In type carry data. Between them,
+  // only an idle gap matters: it ends any packet.
+  if (((pulse & IR_PULSE_LEVEL) ? HIGH : LOW) != Protocol::pulseInType) {
+    if (symbol == IR_SYMBOL_GAP) {
+      return this->endFrame(packet);
+    }
+    return 0;
+  }
+  
+  // A start pulse begins a new packet. A data pulse is appended to the
+  // current packet, once the start pulse (if defined) or an idle gap has
+  // been seen. A pulse outside every window drops the partial packet; as
+  // the first pulse of a packet, it is taken for a distorted start pulse.
+  if (symbol == IR_SYMBOL_START) {
+    this->reset();
+    this->rxStarted = 1;
+    this->rxSynced = 1;
+    this->measure(symbol, width);
+    return 0;
+  } else if (symbol <= IR_SYMBOL_ONE) {
+    if (Protocol::startPulseDuration && !this->rxSynced) {
+      return 0;
+    }
+    
+    this->rxPacket = ((this->rxPacket << 1) | symbol) & packetMask;
+    this->measure(symbol, width);
+    
+    // Drop the packet as soon as it cannot match the signature. Without
+    // a start pulse, the next packet may already have begun.
+    if (!this->matches(this->rxPacketBits + 1)) {
+      if (Protocol::startPulseDuration) {
+        this->reset();
+      } else {
+        ++this->rxPacketBits;
+        this->realign();
+      }
+      return 0;
+    }
+  } else if (symbol == IR_SYMBOL_GAP) {
+    return this->endFrame(packet);
+  } else {
+    uint8_t synced = this->rxSynced && !this->rxPacketBits;
+    
+    if (this->rxPacketBits) {
+      this->miss();
+    }
+    
+    this->reset();
+    this->rxSynced = synced;
+    return 0;
+  }
+  
+  // Without its start pulse, a packet is only complete at the next gap,
+  // as further bits would show it was not a packet boundary after all
+  if (Protocol::startPulseDuration && !this->rxStarted) {
+    if (this->rxPacketBits <= Protocol::packetBits) {
+      ++this->rxPacketBits;
+      this->nextWord();
+    }
+    return 0;
+  }
+  
+  if (++this->rxPacketBits < Protocol::packetBits) {
+    this->nextWord();
+    return 0;
+  }
+  
+  // The packet is complete. Return it if it is valid, and reset the
+  // decoder for the next packet. Without a start pulse, an invalid packet
+  // may have been misaligned: the decoder slides past its first bit, as
+  // long as the whole packet fits in one word.
+  uint8_t valid = this->complete(packet);
+  
+  if (!valid && !Protocol::startPulseDuration && packetWords == 1) {
+    --this->rxPacketBits;
+    this->realign();
+    return 0;
+  }
+  
+  this->reset();
+  return valid;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * IR Frame Queue
+ *
+ * This library passes encoded TX frames from the main loop to the TX
+ * interrupt without locking.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_FRAME_QUEUE_H_
+#define _IR_FRAME_QUEUE_H_
+
+#include <inttypes.h>
+
+/**
+ * Keeps the compiler from moving memory accesses across this point. Frame
+ * contents must be written before the queue index that publishes them.
+ */
+#define IR_MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/**
+ * Single-producer / single-consumer ring of frames. Size must be a power of
+ * two (at most 128).
+ *
+ * Ownership: the producer (the main loop) fills the slot returned by back()
+ * and publishes it with push(); it is the only writer of 'head'. The
+ * consumer (the TX ISR) reads the slot returned by front() and releases it
+ * with pop(); it is the only writer of 'tail'. A slot belongs to exactly one
+ * side at any time, so neither side ever needs to disable interrupts.
+ */
+template <class Frame, uint8_t Size>
+class IRFrameQueue {
+  public:
+    IRFrameQueue() : head(0), tail(0) {}
+    
+    inline uint8_t isEmpty() const {
+      return this->head == this->tail;
+    }
+    
+    inline uint8_t isFull() const {
+      return (uint8_t)(this->head - this->tail) == Size;
+    }
+    
+    /**
+     * Producer side: slot to fill with the next frame, or 0 if the queue
+     * is full.
+     */
+    inline Frame *back() {
+      return this->isFull() ? 0 : &this->frames[this->head & (Size - 1)];
+    }
+    
+    /**
+     * Producer side: publishes the slot returned by back().
+     */
+    inline void push() {
+      IR_MEMORY_BARRIER();
+      this->head = this->head + 1;
+    }
+    
+    /**
+     * Producer side: newest published frame, or 0 if the queue is empty.
+     * The consumer may be reading it, or release it at any time.
+     */
+    inline Frame *last() {
+      return this->isEmpty() ? 0 : &this->frames[(this->head - 1) & (Size - 1)];
+    }
+    
+    /**
+     * Consumer side: oldest published frame, or 0 if the queue is empty.
+     */
+    inline Frame *front() {
+      return this->isEmpty() ? 0 : &this->frames[this->tail & (Size - 1)];
+    }
+    
+    /**
+     * Consumer side: releases the slot returned by front().
+     */
+    inline void pop() {
+      IR_MEMORY_BARRIER();
+      this->tail = this->tail + 1;
+    }
+    
+  private:
+    Frame frames[Size];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * IR Hardware Abstraction Layer
+ *
+ * This library selects the hardware backend used by the IR libraries.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_HAL_H_
+#define _IR_HAL_H_
+
+/**
+ * Every backend provides the Arduino core functions used by the libraries
+ * (pinMode(), digitalRead(), millis(), micros(), PROGMEM, pgm_read_byte(),
+ * ...) and an IRHal class with the following static members:
+ *
+ * void carrierEnable(uint8_t khz)
+ *   Sets up the carrier generator on the TX pin, stopped, with the LED off.
+ * void carrierStart() / void carrierStop()
+ *   Starts / stops the carrier generator. It only runs while a packet is
+ *   being sent, and must not be stopped with the LED on.
+ * void carrierOn() / void carrierOff()
+ *   Connects / disconnects the carrier to the TX pin.
+ * void txTimerEnable()
+ *   Starts the free-running TX timer (IR_TX_TICKS_PER_US ticks per
+ *   microsecond) with its compare interrupt disabled. Also called by the
+ *   RX path, which times pulses with it; leaves the RX timeout alone.
+ * void txTimerArm(uint16_t ticks)
+ *   Enables the compare interrupt, to fire the given number of ticks from now.
+ * void txTimerNext(uint16_t ticks)
+ *   Moves the next compare the given number of ticks past the previous one.
+ * uint16_t txTimerCount() / uint16_t txTimerCompare()
+ *   Reads the TX timer's counter / the tick of its next compare match.
+ * void txTimerDisarm() / uint8_t txTimerArmed()
+ *   Disables / reports the compare interrupt.
+ * void rxEnable(uint8_t pin)
+ *   Enables the pin change interrupt of the RX pin.
+ * uint8_t rxRead()
+ *   Reads the level (HIGH or LOW) of the RX pin given to rxEnable().
+ * void rxTimeoutArm(uint16_t tick)
+ *   Enables the RX timeout interrupt, to fire when the TX timer next
+ *   reaches the given tick.
+ * void rxTimeoutDisarm() / uint8_t rxTimeoutPending()
+ *   Disables the RX timeout interrupt / reports that it is due but has not
+ *   run yet.
+ * uint8_t disableInterrupts() / void restoreInterrupts(uint8_t)
+ *   Enters / leaves a critical section.
+ * void sleep()
+ *   Sleeps until the next interrupt, leaving every timer running. Must be
+ *   called with interrupts disabled; returns with interrupts enabled.
+ *
+ * The backend's interrupt handlers call IR::handleTxInterrupt() on each TX
+ * timer compare match, IR::handleRxInterrupt() on each RX pin change and
+ * IR::handleRxTimeoutInterrupt() on the RX timeout.
+ */
+#ifdef __AVR__
+#include "IRHalAvr.h"
+#else
+#include <IRHalHost.h>
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * IR Hardware Abstraction Layer - AVR backend
+ *
+ * This library drives the ATmega328P timers and pin change interrupts used
+ * by the IR libraries.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ *
+ * PWM logic taken with modifications from:
+ * https://github.com/shirriff/Arduino-IRremote/blob/master/IRremoteInt.h
+ */
+#ifdef __AVR__
+#include "IR.h"
+
+#define SYSCLOCK 16000000  // main Arduino clock
+
+#define TIMER_PWM_PIN 3
+
+volatile uint8_t *IRHal::rxInput;
+uint8_t IRHal::rxMask;
+
+/**
+ * Interrupt Service Routine configured to run on TIMER1 compare matches, which
+ * are scheduled to fire exactly at the next TX edge.
+ */
+ISR(TIMER1_COMPA_vect)
+{
+  IR::handleTxInterrupt();
+}
+
+/**
+ * Interrupt Service Routine configured to run on TIMER1 compare matches on
+ * OCR1B, which are scheduled to fire when an RX pulse times out.
+ */
+ISR(TIMER1_COMPB_vect)
+{
+  IR::handleRxTimeoutInterrupt();
+}
+
+/**
+ * Interrupt Service Routines configured to run on pin changes. The RX pin can
+ * live on any of the three ports, so all pin change vectors share the handler.
+ */
+ISR(PCINT0_vect)
+{
+  IR::handleRxInterrupt();
+}
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+
+/**
+  * Sets up IR output.  The khz value controls the modulation frequency in kilohertz.
+  * The IR output will be on pin 3 (OC2B).
+  * This routine is designed for 36-40KHz; if you use it for other values, it's up to you
+  * to make sure it gives reasonable results.  (Watch out for overflow / underflow / rounding.)
+  * TIMER2 is used in phase-correct PWM mode, with OCR2A controlling the frequency and OCR2B
+  * controlling the duty cycle.
+  * There is no prescaling, so the output frequency is 16MHz / (2 * OCR2A)
+  * To turn the output on and off, we leave the PWM running, but connect and disconnect the output pin.
+  * Between packets, TIMER2's clock is stopped altogether (see carrierStart()).
+  * A few hours staring at the ATmega documentation and this will all make sense.
+  * See Ken Shirriff's Secrets of Arduino PWM at http://arcfn.com/2009/07/secrets-of-arduino-pwm.html for details.
+  */
+void IRHal::carrierEnable(uint8_t khz)
+{
+  IRFastPin<TIMER_PWM_PIN>::output();
+  IRFastPin<TIMER_PWM_PIN>::low(); // When not sending PWM, we want it low
+  
+  // COM2A = 00: disconnect OC2A
+  // COM2B = 00: disconnect OC2B; to send signal set to 10: OC2B non-inverted
+  // WGM2 = 101: phase-correct PWM with OCRA as top
+  // CS2 = 000: stopped; carrierStart() sets 001: no prescaling
+  // The top value for the timer.  The modulation frequency will be SYSCLOCK / 2 / OCR2A.
+  const uint8_t pwmval = SYSCLOCK / 2000 / khz;
+  TCCR2A = _BV(WGM20);
+  TCCR2B = _BV(WGM22);
+  OCR2A = pwmval;
+  OCR2B = pwmval / 3;
+  TIMSK2 = 0;
+}
+
+/**
+ * TIMER1 runs freely in normal mode and times the TX edges: each compare
+ * match on OCR1A fires at the next edge, so the ISR only runs when the
+ * LED actually changes. It also times the RX pulses, whose timeout is
+ * matched on OCR1B; both RX and TX start it, so the RX timeout is left
+ * alone. This makes TIMER1 unavailable to analogWrite() on pins 9 and 10.
+ */
+void IRHal::txTimerEnable()
+{
+  // WGM1 = 0000: normal mode
+  // CS1 = 010: SYSCLOCK / 8
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11);
+  TIMSK1 &= ~_BV(OCIE1A);
+}
+
+/**
+ * Attaches a pin change interrupt to the RX pin, and caches the pin's input
+ * register and bit for rxRead().
+ *
+ * @param pin Pin hooked up to the IR receiver's data line
+ */
+void IRHal::rxEnable(uint8_t pin)
+{
+  rxInput = portInputRegister(digitalPinToPort(pin));
+  rxMask = digitalPinToBitMask(pin);
+  
+  *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+  PCIFR |= _BV(digitalPinToPCICRbit(pin));
+  *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+}
+
+#endif
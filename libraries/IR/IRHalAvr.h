@@ -0,0 +1,173 @@
+/**
+ * IR Hardware Abstraction Layer - AVR backend
+ *
+ * This library drives the ATmega328P timers and pin change interrupts used
+ * by the IR libraries.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_HAL_AVR_H_
+#define _IR_HAL_AVR_H_
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <inttypes.h>
+
+/**
+ * Direct access to an Arduino pin whose number is known at compile time.
+ * The port and bit are resolved by the compiler (ATmega328P: pins 0-7 on
+ * PORTD, 8-13 on PORTB, 14-19 on PORTC), so each call is a single sbi, cbi
+ * or sbic instruction instead of the pin table lookups and PWM check done
+ * by pinMode(), digitalWrite() and digitalRead(). Unlike digitalWrite(), it
+ * does not disconnect a PWM output from the pin.
+ */
+template <uint8_t Pin>
+class IRFastPin {
+  public:
+    static const uint8_t mask = _BV(Pin < 8 ? Pin : Pin < 14 ? Pin - 8 : Pin - 14);
+    
+    static inline volatile uint8_t &pinRegister() {
+      return Pin < 8 ? PIND : Pin < 14 ? PINB : PINC;
+    }
+    
+    static inline volatile uint8_t &ddrRegister() {
+      return Pin < 8 ? DDRD : Pin < 14 ? DDRB : DDRC;
+    }
+    
+    static inline volatile uint8_t &portRegister() {
+      return Pin < 8 ? PORTD : Pin < 14 ? PORTB : PORTC;
+    }
+    
+    static inline void output() {
+      ddrRegister() |= mask;
+    }
+    
+    static inline void input() {
+      ddrRegister() &= ~mask;
+    }
+    
+    static inline void high() {
+      portRegister() |= mask;
+    }
+    
+    static inline void low() {
+      portRegister() &= ~mask;
+    }
+    
+    static inline uint8_t read() {
+      return (pinRegister() & mask) ? HIGH : LOW;
+    }
+};
+
+class IRHal {
+  public:
+    static void carrierEnable(uint8_t);
+    static void txTimerEnable();
+    static void rxEnable(uint8_t);
+    
+    /**
+     * The RX pin is only known at run time, so its input register and bit
+     * are looked up once by rxEnable() and read directly by the RX ISR.
+     */
+    static inline uint8_t rxRead() {
+      return (*rxInput & rxMask) ? HIGH : LOW;
+    }
+    
+    static inline void carrierStart() {
+      TCCR2B |= _BV(CS20);
+    }
+    
+    static inline void carrierStop() {
+      TCCR2B &= ~_BV(CS20);
+    }
+    
+    static inline void carrierOn() {
+      TCCR2A |= _BV(COM2B1);
+    }
+    
+    static inline void carrierOff() {
+      TCCR2A &= ~_BV(COM2B1);
+    }
+    
+    static inline void txTimerArm(uint16_t ticks) {
+      OCR1A = TCNT1 + ticks;
+      TIFR1 = _BV(OCF1A);
+      TIMSK1 |= _BV(OCIE1A);
+    }
+    
+    static inline void txTimerNext(uint16_t ticks) {
+      OCR1A += ticks;
+    }
+    
+    static inline uint16_t txTimerCount() {
+      return TCNT1;
+    }
+    
+    static inline uint16_t txTimerCompare() {
+      return OCR1A;
+    }
+    
+    static inline void txTimerDisarm() {
+      TIMSK1 &= ~_BV(OCIE1A);
+    }
+    
+    static inline uint8_t txTimerArmed() {
+      return TIMSK1 & _BV(OCIE1A);
+    }
+    
+    static inline void rxTimeoutArm(uint16_t tick) {
+      OCR1B = tick;
+      TIFR1 = _BV(OCF1B);
+      TIMSK1 |= _BV(OCIE1B);
+    }
+    
+    static inline void rxTimeoutDisarm() {
+      TIMSK1 &= ~_BV(OCIE1B);
+    }
+    
+    static inline uint8_t rxTimeoutPending() {
+      return (TIMSK1 & _BV(OCIE1B)) && (TIFR1 & _BV(OCF1B));
+    }
+    
+    static inline uint8_t disableInterrupts() {
+      uint8_t oldSREG = SREG;
+      cli();
+      return oldSREG;
+    }
+    
+    static inline void restoreInterrupts(uint8_t oldSREG) {
+      SREG = oldSREG;
+    }
+    
+    /**
+     * Idle mode keeps TIMER1 and the pin change interrupts running, and
+     * TIMER0, so millis() is kept and its overflow wakes the CPU every
+     * 1024us. The instruction after sei() always runs, so an interrupt
+     * cannot slip in between and leave the CPU asleep.
+     */
+    static inline void sleep() {
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_enable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+    }
+    
+  private:
+    static volatile uint8_t *rxInput;
+    static uint8_t rxMask;
+};
+
+#endif
@@ -0,0 +1,140 @@
+/**
+ * IR Latency
+ *
+ * This library measures the time it takes a received IR command to come out
+ * of the transmitter, stage by stage, into a compact histogram.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "IRLatency.h"
+
+/**
+ * Construct an empty set of histograms, with no measurement in progress.
+ */
+IRLatency::IRLatency()
+  : stage(0),
+    startTime(0),
+    stageTime(0)
+{
+  this->reset();
+}
+
+/**
+ * Clears the histograms. A measurement in progress is kept.
+ */
+void IRLatency::reset()
+{
+  for (uint8_t histogram = 0; histogram < IR_LATENCY_HISTOGRAMS; ++histogram) {
+    for (uint8_t bucket = 0; bucket < IR_LATENCY_BUCKETS; ++bucket) {
+      this->counts[histogram][bucket] = 0;
+    }
+  }
+  
+  this->dropped = 0;
+}
+
+/**
+ * Starts measuring a new command (stage FRAME_START). A measurement still
+ * in progress is dropped.
+ *
+ * @param time Time at which the received packet started, in microseconds
+ */
+void IRLatency::begin(uint32_t time)
+{
+  if (this->stage != IR_LATENCY_FRAME_START && this->dropped < 0xFFFF) {
+    ++this->dropped;
+  }
+  
+  this->startTime = time;
+  this->stageTime = time;
+  this->stage = IR_LATENCY_FRAME_START + 1;
+}
+
+/**
+ * Records that the command being measured reached a stage. Stages must be
+ * marked in order; any other stage is ignored. Marking EMITTED completes
+ * the measurement.
+ *
+ * @param stage Stage reached
+ * @param time Time at which it was reached, in microseconds
+ */
+void IRLatency::mark(uint8_t stage, uint32_t time)
+{
+  if (stage != this->stage || stage == IR_LATENCY_FRAME_START) {
+    return;
+  }
+  
+  this->count(stage, time - this->stageTime);
+  this->stageTime = time;
+  
+  if (++this->stage == IR_LATENCY_STAGES) {
+    this->count(0, time - this->startTime);
+    this->stage = IR_LATENCY_FRAME_START;
+  }
+}
+
+/**
+ * Next stage expected by mark(), or FRAME_START if no measurement is in
+ * progress.
+ */
+uint8_t IRLatency::getStage()
+{
+  return this->stage;
+}
+
+/**
+ * Number of intervals counted in a histogram bucket
+ *
+ * @param histogram Histogram (see IR_LATENCY_HISTOGRAMS)
+ * @param bucket Bucket (see IR_LATENCY_BUCKETS)
+ */
+uint16_t IRLatency::getCount(uint8_t histogram, uint8_t bucket)
+{
+  return this->counts[histogram][bucket];
+}
+
+/**
+ * Number of measurements dropped before reaching EMITTED
+ */
+uint16_t IRLatency::getDropped()
+{
+  return this->dropped;
+}
+
+/**
+ * Bucket counting an interval
+ *
+ * @param interval Interval in microseconds
+ */
+uint8_t IRLatency::getBucket(uint32_t interval)
+{
+  uint8_t bucket = 0;
+  
+  interval >>= IR_LATENCY_SHIFT - 1;
+  
+  while (interval > 1 && bucket < IR_LATENCY_BUCKETS - 1) {
+    interval >>= 1;
+    ++bucket;
+  }
+  
+  return bucket;
+}
+
+/**
+ * Counts an interval in a histogram. Counts saturate.
+ */
+void IRLatency::count(uint8_t histogram, uint32_t interval)
+{
+  uint16_t *count = &this->counts[histogram][IRLatency::getBucket(interval)];
+  
+  if (*count < 0xFFFF) {
+    ++*count;
+  }
+}
@@ -0,0 +1,115 @@
+/**
+ * IR Latency
+ *
+ * This library measures the time it takes a received IR command to come out
+ * of the transmitter, stage by stage, into a compact histogram.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_LATENCY_H_
+#define _IR_LATENCY_H_
+
+#include "IR.h"
+
+/**
+ * Stages of a command, in the order they must be marked:
+ * - FRAME_START: the received packet started (see IRProtocol::getPacketDuration())
+ * - FRAME_END: its last pulse ended (see IR::getPulseEndTime())
+ * - DECODED: the main loop got the packet from the decoder
+ * - APPLIED: the command was applied to the transmitter's state
+ * - QUEUED: the first packet carrying it was queued
+ * - EMITTED: the TX ISR sent that packet's first edge (see IR::getTxStart())
+ */
+#define IR_LATENCY_FRAME_START 0
+#define IR_LATENCY_FRAME_END   1
+#define IR_LATENCY_DECODED     2
+#define IR_LATENCY_APPLIED     3
+#define IR_LATENCY_QUEUED      4
+#define IR_LATENCY_EMITTED     5
+#define IR_LATENCY_STAGES      6
+
+/**
+ * A histogram is kept for the interval ending at each stage (histogram n is
+ * stage n - 1 to stage n), and histogram 0 holds the total, FRAME_START to
+ * EMITTED.
+ */
+#define IR_LATENCY_HISTOGRAMS IR_LATENCY_STAGES
+
+/**
+ * Histogram buckets are powers of two: bucket 0 counts intervals below
+ * 2^IR_LATENCY_SHIFT us, bucket n (n > 0) intervals from 2^(n + SHIFT - 1)
+ * up to 2^(n + SHIFT) us. The last bucket also counts everything longer.
+ */
+#define IR_LATENCY_BUCKETS 16
+#define IR_LATENCY_SHIFT   5
+
+/**
+ * Dump format: the magic bytes and version, the number of histograms, the
+ * number of buckets and the bucket shift (one byte each), the number of
+ * dropped measurements, then every count, histogram by histogram. All
+ * counts are 16-bit little endian.
+ */
+#define IR_LATENCY_MAGIC   "IRL"
+#define IR_LATENCY_VERSION 1
+
+class IRLatency {
+  public:
+    IRLatency();
+    
+    void begin(uint32_t);
+    void mark(uint8_t, uint32_t);
+    void reset();
+    
+    uint8_t getStage();
+    uint16_t getCount(uint8_t, uint8_t);
+    uint16_t getDropped();
+    
+    static uint8_t getBucket(uint32_t);
+    
+    /**
+     * Writes the histograms in the dump format.
+     *
+     * @param out Stream to write to (e.g. Serial)
+     */
+    template <class Output>
+    void dump(Output &out) {
+      const char *magic = IR_LATENCY_MAGIC;
+      
+      while (*magic) {
+        out.write((uint8_t)*magic++);
+      }
+      
+      out.write((uint8_t)IR_LATENCY_VERSION);
+      out.write((uint8_t)IR_LATENCY_HISTOGRAMS);
+      out.write((uint8_t)IR_LATENCY_BUCKETS);
+      out.write((uint8_t)IR_LATENCY_SHIFT);
+      out.write((uint8_t)this->dropped);
+      out.write((uint8_t)(this->dropped >> 8));
+      
+      for (uint8_t histogram = 0; histogram < IR_LATENCY_HISTOGRAMS; ++histogram) {
+        for (uint8_t bucket = 0; bucket < IR_LATENCY_BUCKETS; ++bucket) {
+          out.write((uint8_t)this->counts[histogram][bucket]);
+          out.write((uint8_t)(this->counts[histogram][bucket] >> 8));
+        }
+      }
+    }
+    
+  private:
+    uint16_t counts[IR_LATENCY_HISTOGRAMS][IR_LATENCY_BUCKETS];
+    uint16_t dropped;
+    
+    uint8_t stage;
+    uint32_t startTime;
+    uint32_t stageTime;
+    
+    void count(uint8_t, uint32_t);
+};
+
+#endif
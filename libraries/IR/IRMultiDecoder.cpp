@@ -0,0 +1,114 @@
+/**
+ * IR Multi Decoder
+ *
+ * This library runs several protocol decoders in parallel over a single
+ * pulse stream.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "IRMultiDecoder.h"
+
+/**
+ * Construct an empty multi decoder.
+ */
+IRMultiDecoder::IRMultiDecoder()
+  : decoderCount(0),
+    completed(0)
+{
+}
+
+/**
+ * Registers a protocol decoder. Its packets cannot exceed IR_MAX_PACKET_BITS.
+ *
+ * @param decoder Decoder to feed with every pulse
+ * @param protocol Tag reported with each frame the decoder completes
+ * @return Boolean indicating whether the decoder was added
+ */
+uint8_t IRMultiDecoder::add(IRDecoder *decoder, uint8_t protocol)
+{
+  if (this->decoderCount == IR_MAX_DECODERS || decoder->getPacketBits() > IR_MAX_PACKET_BITS) {
+    return 0;
+  }
+  
+  this->decoders[this->decoderCount] = decoder;
+  this->protocols[this->decoderCount] = protocol;
+  ++this->decoderCount;
+  
+  return 1;
+}
+
+/**
+ * Returns the next frame completed by a previous pulse, if any. Two
+ * protocols may complete a frame on the same pulse, in which case the
+ * frames are reported one after the other.
+ *
+ * @param frame Variable that will store the frame
+ * @return Boolean indicating whether a frame was pending
+ */
+uint8_t IRMultiDecoder::nextFrame(IRFrame *frame)
+{
+  for (uint8_t i = 0; i < this->decoderCount; ++i) {
+    if (this->completed & _BV(i)) {
+      this->completed &= ~_BV(i);
+      frame->protocol = this->protocols[i];
+      
+      for (uint8_t word = 0; word < IR_PACKET_WORDS(IR_MAX_PACKET_BITS); ++word) {
+        frame->words[word] = this->packets[i][word];
+      }
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+/**
+ * Feeds a single pulse to every registered decoder. Frames still pending
+ * from earlier pulses are reported first.
+ *
+ * @param pulse Captured pulse (level and width)
+ * @param frame Variable that will store the frame
+ * @return Boolean indicating whether a frame was completed
+ */
+uint8_t IRMultiDecoder::decode(uint16_t pulse, IRFrame *frame)
+{
+  for (uint8_t i = 0; i < this->decoderCount; ++i) {
+    if (this->decoders[i]->decode(pulse, this->packets[i])) {
+      this->completed |= _BV(i);
+    }
+  }
+  
+  return this->nextFrame(frame);
+}
+
+/**
+ * Decodes the pulses captured by a receiver since the last call without
+ * blocking, stopping at the first completed frame.
+ *
+ * @param source IR instance whose receiver captures the pulses
+ * @param frame Variable that will store the frame
+ * @return Boolean indicating whether a frame was received
+ */
+uint8_t IRMultiDecoder::poll(IR *source, IRFrame *frame)
+{
+  uint16_t pulse;
+  
+  if (this->nextFrame(frame)) {
+    return 1;
+  }
+  
+  while (source->readPulse(&pulse)) {
+    if (this->decode(pulse, frame)) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
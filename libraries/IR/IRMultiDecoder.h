@@ -0,0 +1,65 @@
+/**
+ * IR Multi Decoder
+ *
+ * This library runs several protocol decoders in parallel over a single
+ * pulse stream.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_MULTI_DECODER_H_
+#define _IR_MULTI_DECODER_H_
+
+#include "IR.h"
+#include "IRDecoder.h"
+
+/**
+ * Maximum number of protocols decoded from one pulse stream
+ */
+#ifndef IR_MAX_DECODERS
+#define IR_MAX_DECODERS 4
+#endif
+
+/**
+ * Packet received by the multi decoder, tagged with the protocol it was
+ * decoded as. Packets of up to 32 bits are in 'packet'; longer packets (up
+ * to IR_MAX_PACKET_BITS) span 'words', of which 'packet' is the first.
+ */
+struct IRFrame {
+  uint8_t protocol;
+  union {
+    uint32_t packet;
+    uint32_t words[IR_PACKET_WORDS(IR_MAX_PACKET_BITS)];
+  };
+};
+
+/**
+ * The IRMultiDecoder feeds every pulse of one receiver to each registered
+ * protocol decoder, so frames from different remotes are recognized as
+ * they arrive, without reading the receiver once per protocol.
+ */
+class IRMultiDecoder {
+  public:
+    IRMultiDecoder();
+    
+    uint8_t add(IRDecoder *, uint8_t);
+    uint8_t decode(uint16_t, IRFrame *);
+    uint8_t poll(IR *, IRFrame *);
+    
+  private:
+    IRDecoder *decoders[IR_MAX_DECODERS];
+    uint8_t protocols[IR_MAX_DECODERS];
+    uint32_t packets[IR_MAX_DECODERS][IR_PACKET_WORDS(IR_MAX_PACKET_BITS)];
+    uint8_t decoderCount;
+    uint8_t completed;
+    
+    uint8_t nextFrame(IRFrame *);
+};
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * IR Power
+ *
+ * This library puts the MCU to sleep between IR events, and measures how
+ * long it stays awake.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "IRPower.h"
+
+/**
+ * Construct a power manager with cleared counters. The clock is not read
+ * until begin().
+ */
+IRPower::IRPower()
+{
+  this->stats = IRPowerStats();
+  this->sleepUs = 0;
+  this->resetTime = 0;
+}
+
+/**
+ * Starts the duty cycle measurement. Should be called from setup().
+ */
+void IRPower::begin()
+{
+  this->resetStats();
+}
+
+/**
+ * Sleeps until the next interrupt, and counts what woke the MCU. Interrupts
+ * are disabled from the edge counts snapshot to the sleep instruction, so an
+ * edge cannot slip in between and leave the MCU asleep with work pending.
+ */
+void IRPower::sleep()
+{
+  IRHal::disableInterrupts();
+  
+  uint8_t rxEdges = IR::getRxEdgeCount();
+  uint8_t txEdges = IR::getTxEdgeCount();
+  uint32_t start = micros();
+  
+  IRHal::sleep();
+  
+  // Sleeps are cut short by the millis() tick, so carrying whole
+  // milliseconds takes a subtraction or two rather than a division
+  this->sleepUs += micros() - start;
+  while (this->sleepUs >= 1000) {
+    this->sleepUs -= 1000;
+    ++this->stats.sleepMs;
+  }
+  ++this->stats.sleeps;
+  
+  if (IR::getRxEdgeCount() != rxEdges) {
+    ++this->stats.rxWakes;
+  } else if (IR::getTxEdgeCount() != txEdges) {
+    ++this->stats.txWakes;
+  } else {
+    ++this->stats.timerWakes;
+  }
+}
+
+/**
+ * Share of the time spent awake since the counters were reset.
+ *
+ * @return Duty cycle, in permille
+ */
+uint16_t IRPower::getDutyCycle()
+{
+  uint32_t elapsed = millis() - this->resetTime;
+  uint32_t asleep;
+  
+  if (elapsed == 0) {
+    return 1000;
+  }
+  
+  // Past about 71 minutes, sleepMs * 1000 no longer fits in 32 bits
+  if (this->stats.sleepMs < 0xFFFFFFFFUL / 1000) {
+    asleep = this->stats.sleepMs * 1000 / elapsed;
+  } else {
+    asleep = this->stats.sleepMs / (elapsed / 1000);
+  }
+  
+  return asleep < 1000 ? 1000 - asleep : 0;
+}
+
+/**
+ * Copies the counters.
+ *
+ * @param stats Variable that will store the counters
+ */
+void IRPower::getStats(IRPowerStats *stats)
+{
+  *stats = this->stats;
+  stats->elapsedMs = millis() - this->resetTime;
+}
+
+/**
+ * Clears the counters and restarts the duty cycle measurement.
+ */
+void IRPower::resetStats()
+{
+  this->stats = IRPowerStats();
+  this->sleepUs = 0;
+  this->resetTime = millis();
+}
@@ -0,0 +1,56 @@
+/**
+ * IR Power
+ *
+ * This library puts the MCU to sleep between IR events, and measures how
+ * long it stays awake.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_POWER_H_
+#define _IR_POWER_H_
+
+#include "IR.h"
+
+/**
+ * Counters kept by IRPower. Each wake is attributed to a single source: an
+ * RX edge if one was captured while sleeping, else a TX edge, else a timer
+ * (the millis() tick on the AVR, which wakes the MCU every 1024us).
+ */
+struct IRPowerStats {
+  uint32_t sleeps;      // Calls to sleep()
+  uint32_t rxWakes;     // Wakes by an RX edge
+  uint32_t txWakes;     // Wakes by the TX timer
+  uint32_t timerWakes;  // Wakes by any other interrupt
+  uint32_t sleepMs;     // Time spent asleep, in milliseconds
+  uint32_t elapsedMs;   // Time since the counters were reset, in milliseconds
+};
+
+/**
+ * The IRPower class is called by the main loop once it has nothing left to
+ * do: the MCU then idles until the next RX edge, TX deadline or timer tick.
+ * The IR timers keep running while asleep, so no edge is missed or delayed.
+ */
+class IRPower {
+  public:
+    IRPower();
+    
+    void begin();
+    void sleep();
+    uint16_t getDutyCycle();
+    void getStats(IRPowerStats *);
+    void resetStats();
+    
+  private:
+    IRPowerStats stats;
+    uint16_t sleepUs;     // Time asleep not yet carried into stats.sleepMs
+    uint32_t resetTime;
+};
+
+#endif
@@ -0,0 +1,295 @@
+/**
+ * IR Protocol
+ *
+ * This library specializes the IR class for a single IR protocol at compile time.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_PROTOCOL_H_
+#define _IR_PROTOCOL_H_
+
+#include "IR.h"
+#include "IRDecoder.h"
+
+/**
+ * The IRProtocol template is parameterized on a protocol traits class, which
+ * describes the protocol with the following static members:
+ *
+ * uint16_t startPulseDuration
+ *   Duration of the start pulse. Not used in every protocol. Set to 0 if unused.
+ * uint16_t shortPulseDuration
+ *   Duration of the pulse used to signify a low bit.
+ * uint16_t longPulseDuration
+ *   Duration of the pulse used to signify a high bit.
+ * uint16_t pulseGapDuration
+ *   Duration of the gap between each pulse
+ * uint32_t gapDuration
+ *   Idle time between packet reception.
+ * uint32_t frameGapDuration
+ *   Minimum idle time after each transmitted packet.
+ * uint16_t pulseTolerance
+ *   Error tolerance allowed when measuring a pulse width.
+ * uint16_t trackingTolerance
+ *   Tolerance once the decoder has locked on the remote's actual pulse
+ *   widths (see IRProtocolDecoder). Set to 0 to disable tracking.
+ * uint8_t pulseInType
+ *   Type to use for reading pulses (either HIGH or LOW)
+ * uint8_t txFrequency
+ *   Frequency of the IR transmission
+ * uint8_t packetBits
+ *   Number of bits in the IR packet. Packets are passed as arrays of
+ *   IR_PACKET_WORDS(packetBits) words, a single uint32_t up to 32 bits.
+ * uint8_t signatureBits
+ *   Number of fixed bits at the start of every IR packet. Set to 0 if unused.
+ * uint32_t signature
+ *   Value of the fixed bits, checked as the packet is received.
+ * uint8_t hasChecksum
+ *   If true, IR packet has a valid checksum routine
+ * static uint8_t checksum(const uint32_t *packet)
+ *   Checksum routine for a received packet
+ *
+ * Pulse and gap durations other than the idle gaps are limited to
+ * IR_MAX_EDGE_TICKS TX ticks (16ms), which tx() checks at compile time.
+ *
+ * Received pulses are decoded by an IRProtocolDecoder, through a lookup
+ * table built from these timings. As every field is a compile-time
+ * constant no other configuration is kept in RAM.
+ */
+template <class Protocol>
+class IRProtocol : public IR {
+  public:
+    IRProtocol(uint8_t, uint8_t);
+    
+    void begin();
+    uint8_t rx(uint32_t *, uint32_t);
+    uint8_t poll(uint32_t *);
+    
+    IRDecoder *getDecoder();
+    
+    static uint32_t getPacketDuration(const uint32_t *);
+    
+  protected:
+    static const uint8_t packetWords = IR_PACKET_WORDS(Protocol::packetBits);
+    
+    // A data pulse is seen by the receiver as the configured Pulse In type.
+    // The receiver's output is LOW while the IR LED is on.
+    static const uint16_t pulseLevel = Protocol::pulseInType == LOW ? IR_EDGE_LEVEL : 0;
+    static const uint16_t gapLevel = pulseLevel ^ IR_EDGE_LEVEL;
+    
+    static const IRTxTimings txTimings;
+    
+    IRProtocolDecoder<Protocol> decoder;
+    
+    uint8_t tx(uint32_t *, uint8_t = 0);
+    uint8_t isWaitingTx(const uint32_t *);
+    void enableIROut();
+};
+
+/**
+ * TX timings of the protocol, shared by all of its packets
+ */
+template <class Protocol>
+const IRTxTimings IRProtocol<Protocol>::txTimings = {
+  IR_TX_TICKS(Protocol::frameGapDuration),
+  1UL << ((Protocol::packetBits - 1) & 31),
+  Protocol::packetBits,
+  Protocol::startPulseDuration ? (IREdge)(pulseLevel | IR_TX_TICKS(Protocol::startPulseDuration)) : (IREdge)0,
+  (IREdge)(gapLevel | IR_TX_TICKS(Protocol::pulseGapDuration)),
+  (IREdge)(pulseLevel | IR_TX_TICKS(Protocol::shortPulseDuration)),
+  (IREdge)(pulseLevel | IR_TX_TICKS(Protocol::longPulseDuration))
+};
+
+/**
+ * Construct a new protocol-specific IR instance.
+ *
+ * @param rxPin Pin hooked up to the IR receiver's data line
+ * @param enableTx Boolean flag indicating whether to enable TX
+ */
+template <class Protocol>
+IRProtocol<Protocol>::IRProtocol(uint8_t rxPin, uint8_t enableTx)
+  : IR(rxPin, enableTx)
+{
+}
+
+/**
+ * Starts the receiver and, if TX is enabled, IR output at the protocol's
+ * frequency. Must be called from setup().
+ */
+template <class Protocol>
+void IRProtocol<Protocol>::begin()
+{
+  IR::begin();
+  
+  if (this->txCapable) {
+    this->enableIROut();
+  }
+}
+
+/**
+ * Returns the decoder used by poll(), so it can also be registered with an
+ * IRMultiDecoder.
+ */
+template <class Protocol>
+IRDecoder *IRProtocol<Protocol>::getDecoder()
+{
+  return &this->decoder;
+}
+
+/**
+ * Duration of a packet on the air, from the start of its start pulse (or of
+ * its first gap, if the protocol has none) to the end of its last pulse.
+ *
+ * @param packet Packet being sent or received (see IR_PACKET_WORDS)
+ * @return Duration in microseconds
+ */
+template <class Protocol>
+uint32_t IRProtocol<Protocol>::getPacketDuration(const uint32_t *packet)
+{
+  uint32_t duration = Protocol::startPulseDuration
+    + (uint32_t)Protocol::packetBits * Protocol::pulseGapDuration;
+  uint8_t ones = 0;
+  
+  for (uint8_t i = 0; i < packetWords; ++i) {
+    for (uint32_t word = packet[i]; word; word &= word - 1) {
+      ++ones;
+    }
+  }
+  
+  return duration + (uint32_t)ones * Protocol::longPulseDuration
+    + (uint32_t)(Protocol::packetBits - ones) * Protocol::shortPulseDuration;
+}
+
+/**
+ * Enables IR output at the protocol's frequency.
+ */
+template <class Protocol>
+void IRProtocol<Protocol>::enableIROut()
+{
+  IR::enableIROut(Protocol::txFrequency);
+}
+
+/**
+ * Decodes the pulses captured since the last call without blocking. Decoder
+ * state is kept between calls, so a packet may span several calls.
+ *
+ * @param packet Variable that will store the packet
+ * @return Boolean indicating whether a complete packet was received
+ */
+template <class Protocol>
+uint8_t IRProtocol<Protocol>::poll(uint32_t *packet)
+{
+  uint16_t pulse;
+  
+  while (this->readPulse(&pulse)) {
+    if (this->decoder.decode(pulse, packet)) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+/**
+ * Reads in an IR packet from the configured RX pin. Blocks until a packet is
+ * decoded or the timeout expires; use poll() to avoid blocking.
+ *
+ * @param packet Variable that will store the packet
+ * @param timeout Maximum execution time of this routine
+ * @return Boolean indicating whether a packet was received
+ */
+template <class Protocol>
+uint8_t IRProtocol<Protocol>::rx(uint32_t *packet, uint32_t timeout)
+{
+  uint32_t startTimeMillis = millis();
+  
+  do {
+    if (this->poll(packet)) {
+      return 1;
+    }
+  } while (timeout == 0 || millis() - startTimeMillis < timeout);
+  
+  return 0;
+}
+
+/**
+ * Called by subclasses to queue a new packet for transmission. The packet is
+ * copied into the TX queue, where the handleTx() method walks its bits and
+ * times each edge from the protocol's timings (txTimings). Packets are sent
+ * back to back, separated by the protocol's frame gap.
+ *
+ * A packet identical to the last one queued is coalesced with it while that
+ * packet is still waiting: once the TX ISR has started it, the packet is
+ * queued again, so it is repeated.
+ *
+ * @param packet Packet to send (see IR_PACKET_WORDS)
+ * @param priority Boolean flag indicating whether the packet should be sent
+ *                 ahead of the packets already queued
+ * @return Boolean indicating whether the packet was queued (or coalesced)
+ */
+template <class Protocol>
+uint8_t IRProtocol<Protocol>::tx(uint32_t *packet, uint8_t priority)
+{
+  static_assert(Protocol::packetBits <= IR_MAX_PACKET_BITS,
+                "Packet too long for the TX queue: raise IR_MAX_PACKET_BITS");
+  
+  // An edge's duration shares its 16 bits with the level (see IREdge)
+  static_assert(IR_TX_TICKS(Protocol::startPulseDuration) <= IR_MAX_EDGE_TICKS,
+                "Start pulse too long for a TX edge");
+  static_assert(IR_TX_TICKS(Protocol::pulseGapDuration) <= IR_MAX_EDGE_TICKS,
+                "Pulse gap too long for a TX edge");
+  static_assert(IR_TX_TICKS(Protocol::shortPulseDuration) <= IR_MAX_EDGE_TICKS,
+                "Short pulse too long for a TX edge");
+  static_assert(IR_TX_TICKS(Protocol::longPulseDuration) <= IR_MAX_EDGE_TICKS,
+                "Long pulse too long for a TX edge");
+  
+  if (!priority && this->isWaitingTx(packet)) {
+    return 1;
+  }
+  
+  IRTxFrame *frame = this->beginTx(priority);
+  
+  if (!frame) {
+    return 0;
+  }
+  
+  for (uint8_t i = 0; i < packetWords; ++i) {
+    frame->words[i] = packet[i];
+  }
+  
+  frame->timings = &txTimings;
+  
+  this->endTx(priority);
+  
+  return 1;
+}
+
+/**
+ * Indicates whether a packet of this protocol, identical to the given one,
+ * is the last in the TX queue and has not been started yet.
+ */
+template <class Protocol>
+uint8_t IRProtocol<Protocol>::isWaitingTx(const uint32_t *packet)
+{
+  const IRTxFrame *frame = this->getWaitingTx();
+  
+  if (!frame || frame->timings != &txTimings) {
+    return 0;
+  }
+  
+  for (uint8_t i = 0; i < packetWords; ++i) {
+    if (packet[i] != frame->words[i]) {
+      return 0;
+    }
+  }
+  
+  return 1;
+}
+
+#endif
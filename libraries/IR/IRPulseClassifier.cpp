@@ -0,0 +1,59 @@
+/**
+ * IR Pulse Classifier
+ *
+ * This library converts measured pulse widths into protocol symbols with a
+ * single table lookup.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include "IRPulseClassifier.h"
+
+/**
+ * Construct a classifier over caller-supplied table storage.
+ *
+ * @param table Table storage
+ * @param buckets Number of entries in the table
+ */
+IRPulseClassifier::IRPulseClassifier(uint8_t *table, uint8_t buckets)
+  : table(table),
+    lastBucket(buckets - 1)
+{
+}
+
+/**
+ * Fills the lookup table from a protocol's timings. A bucket is given a
+ * symbol when its center lies within that symbol's tolerance window. Buckets
+ * outside every window are invalid, except for the last one, which covers
+ * all pulses longer than the longest symbol and is treated as a gap.
+ *
+ * @param startPulse Duration of the start pulse (0 if unused)
+ * @param shortPulse Duration of the pulse used to signify a low bit
+ * @param longPulse Duration of the pulse used to signify a high bit
+ * @param tolerance Error tolerance allowed when measuring a pulse width
+ */
+void IRPulseClassifier::build(uint16_t startPulse, uint16_t shortPulse, uint16_t longPulse, uint16_t tolerance)
+{
+  for (uint8_t bucket = 0; bucket < this->lastBucket; ++bucket) {
+    uint16_t center = ((uint16_t)bucket << IR_CLASSIFIER_SHIFT) + (1 << (IR_CLASSIFIER_SHIFT - 1));
+    uint8_t symbol = IR_SYMBOL_INVALID;
+    
+    if (center + tolerance > shortPulse && center < shortPulse + tolerance) {
+      symbol = IR_SYMBOL_ZERO;
+    } else if (center + tolerance > longPulse && center < longPulse + tolerance) {
+      symbol = IR_SYMBOL_ONE;
+    } else if (startPulse && center + tolerance > startPulse && center < startPulse + tolerance) {
+      symbol = IR_SYMBOL_START;
+    }
+    
+    this->table[bucket] = symbol;
+  }
+  
+  this->table[this->lastBucket] = IR_SYMBOL_GAP;
+}
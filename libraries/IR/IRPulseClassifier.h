@@ -0,0 +1,88 @@
+/**
+ * IR Pulse Classifier
+ *
+ * This library converts measured pulse widths into protocol symbols with a
+ * single table lookup.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */ 
+#ifndef _IR_PULSE_CLASSIFIER_H_
+#define _IR_PULSE_CLASSIFIER_H_
+
+#include <inttypes.h>
+
+/**
+ * Symbols produced by the classifier. The data symbols equal the bit they
+ * encode, so they can be shifted straight into a packet.
+ */
+#define IR_SYMBOL_ZERO    0
+#define IR_SYMBOL_ONE     1
+#define IR_SYMBOL_START   2
+#define IR_SYMBOL_GAP     3
+#define IR_SYMBOL_INVALID 4
+
+/**
+ * Pulse widths are quantized into buckets of 2^IR_CLASSIFIER_SHIFT
+ * microseconds (32us by default).
+ */
+#ifndef IR_CLASSIFIER_SHIFT
+#define IR_CLASSIFIER_SHIFT 5
+#endif
+
+/**
+ * Number of buckets needed to classify pulses up to the given width. The
+ * extra bucket catches every longer pulse and is classified as a gap.
+ * Cannot exceed 255.
+ */
+#define IR_CLASSIFIER_BUCKETS(maxWidth) (((maxWidth) >> IR_CLASSIFIER_SHIFT) + 2)
+
+/**
+ * The IRPulseClassifier maps a pulse width to a symbol through a lookup
+ * table, so the per-pulse cost is constant regardless of how many symbols
+ * the protocol defines. Storage for the table is supplied by IRPulseTable.
+ */
+class IRPulseClassifier {
+  public:
+    void build(uint16_t, uint16_t, uint16_t, uint16_t);
+    
+    /**
+     * Classifies a pulse.
+     *
+     * @param width Pulse width in microseconds
+     * @return One of the IR_SYMBOL_* values
+     */
+    inline uint8_t classify(uint16_t width) const {
+      uint16_t bucket = width >> IR_CLASSIFIER_SHIFT;
+      
+      return this->table[bucket < this->lastBucket ? bucket : this->lastBucket];
+    }
+    
+  protected:
+    IRPulseClassifier(uint8_t *, uint8_t);
+    
+  private:
+    uint8_t *table;
+    uint8_t lastBucket;
+};
+
+/**
+ * Classifier with room for the given number of buckets (see
+ * IR_CLASSIFIER_BUCKETS).
+ */
+template <uint8_t Buckets>
+class IRPulseTable : public IRPulseClassifier {
+  public:
+    IRPulseTable() : IRPulseClassifier(storage, Buckets) {}
+    
+  private:
+    uint8_t storage[Buckets];
+};
+
+#endif
@@ -0,0 +1,268 @@
+/**
+ * IR Cycle Benchmark
+ *
+ * Firmware measuring the cost of the IR libraries' hot paths on an
+ * ATmega328P, meant to be run under simavr (see the Makefile). TIMER1 is
+ * switched to SYSCLOCK / 1 and read around each call, so every result is
+ * an exact cycle count, net of the measurement overhead.
+ *
+ * Results are written to the simavr console (GPIOR0) as one
+ * "name value" pair per line. The interrupt figures cover the handlers
+ * called by the vectors; the vectors' register save and restore adds a
+ * constant on top.
+ *
+ * This project serves as partial fulfillment of my Master's 
+ * of Science in Computer Science at Rochester Institute of Technology. 
+ *
+ * Created: 2013-03-24
+ * Author: Ken Beck (http://geekken.net/)
+ *
+ * An in-depth analysis of this project can be found at:
+ * http://blog.geekken.net/2013/03/23/masters-project-final-report/
+ */
+#include <IR.h>
+#include <IRMultiDecoder.h>
+#include <GyropterIR.h>
+#include <AirSwimmerIR.h>
+#include <CoopScheduler.h>
+
+#include <avr/sleep.h>
+#include <stdlib.h>
+#include <avr/avr_mcu_section.h>
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+// Number of calls measured per function
+#define CYCLES_RUNS 64
+
+// Pin the RX benchmark toggles to emulate a receiver
+#define CYCLES_RX_PIN 5
+
+/**
+ * Exposes the protected packet routine
+ */
+class CyclesAirSwimmerIR : public AirSwimmerIR {
+  public:
+    void sendPacket() { AirSwimmerIR::sendPacket(); }
+};
+
+/**
+ * Minimum, maximum and total of a series of measurements
+ */
+struct CyclesStat {
+  uint16_t min;
+  uint16_t max;
+  uint32_t total;
+  uint16_t count;
+};
+
+// Cycles spent reading TIMER1 right after clearing it
+static uint16_t overhead;
+
+static GyropterIR gyropter(CYCLES_RX_PIN);
+static CyclesAirSwimmerIR airswimmer;
+static CoopScheduler scheduler;
+
+// Pulses captured by the RX interrupt (see IR.cpp)
+extern IRPulseBuffer pulseBuffer;
+
+static inline void cyclesStart()
+{
+  TCNT1 = 0;
+}
+
+static inline uint16_t cyclesStop()
+{
+  uint16_t cycles = TCNT1;
+  return cycles - overhead;
+}
+
+static void cyclesAdd(CyclesStat *stat, uint16_t cycles)
+{
+  if (stat->count == 0 || cycles < stat->min) {
+    stat->min = cycles;
+  }
+  if (cycles > stat->max) {
+    stat->max = cycles;
+  }
+  stat->total += cycles;
+  ++stat->count;
+}
+
+static void consolePrint(const char *text)
+{
+  while (*text) {
+    GPIOR0 = *text++;
+  }
+}
+
+static void consoleValue(const char *name, const char *suffix, uint32_t value)
+{
+  char digits[11];
+  
+  consolePrint(name);
+  consolePrint(suffix);
+  consolePrint(" ");
+  consolePrint(ultoa(value, digits, 10));
+  consolePrint("\n");
+}
+
+static void consoleStat(const char *name, const CyclesStat *stat)
+{
+  consoleValue(name, "_min_cycles", stat->min);
+  consoleValue(name, "_max_cycles", stat->max);
+  consoleValue(name, "_mean_cycles", stat->count ? stat->total / stat->count : 0);
+}
+
+/**
+ * Appends the pulses of a Gyropter packet to the RX pulse buffer, as the
+ * RX interrupt would have captured them.
+ *
+ * @return Number of pulses
+ */
+static uint8_t pushGyropterPacket(uint32_t packet)
+{
+  const uint16_t gap = IR_PULSE_LEVEL | GyropterIRProtocol::pulseGapDuration;
+  uint8_t count = 0;
+  
+  pulseBuffer.push(gap);
+  pulseBuffer.push(GyropterIRProtocol::startPulseDuration);
+  count += 2;
+  
+  for (uint8_t bit = GyropterIRProtocol::packetBits; bit > 0; --bit) {
+    pulseBuffer.push(gap);
+    pulseBuffer.push(bitRead(packet, bit - 1) 
+      ? GyropterIRProtocol::longPulseDuration : GyropterIRProtocol::shortPulseDuration);
+    count += 2;
+  }
+  
+  pulseBuffer.push(IR_PULSE_LEVEL | IR_PULSE_WIDTH);
+  return count + 1;
+}
+
+/**
+ * Plays back the queued TX packets by calling the TX interrupt handler
+ * until the queues are empty.
+ */
+static void drainTx(IR *ir, CyclesStat *isr)
+{
+  while (ir->isTransmitting()) {
+    cyclesStart();
+    IR::handleTxInterrupt();
+    cyclesAdd(isr, cyclesStop());
+  }
+}
+
+/**
+ * Task doing nothing, to time the scheduler alone
+ */
+static void cyclesEmptyTask()
+{
+}
+
+void setup()
+{
+  // millis() must be past the Air Swimmer's command timeout before
+  // interrupts are disabled for the measurements
+  delay(1100);
+  
+  gyropter.begin();
+  airswimmer.begin();
+  
+  cli();
+  
+  // TIMER1 counts CPU cycles from here on
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  
+  cyclesStart();
+  overhead = TCNT1;
+  
+  CyclesStat rxIsr = {0, 0, 0, 0};
+  CyclesStat txIsr = {0, 0, 0, 0};
+  CyclesStat poll = {0, 0, 0, 0};
+  CyclesStat command = {0, 0, 0, 0};
+  CyclesStat sendPacket = {0, 0, 0, 0};
+  CyclesStat dispatch = {0, 0, 0, 0};
+  uint32_t pulses = 0;
+  uint32_t seed = 0x2545F491;
+  
+  // RX interrupt: the receiver's output is emulated by driving the RX pin
+  pinMode(CYCLES_RX_PIN, OUTPUT);
+  uint16_t pulse;
+  
+  for (uint8_t run = 0; run < CYCLES_RUNS; ++run) {
+    digitalWrite(CYCLES_RX_PIN, !digitalRead(CYCLES_RX_PIN));
+    cyclesStart();
+    IR::handleRxInterrupt();
+    cyclesAdd(&rxIsr, cyclesStop());
+    
+    while (gyropter.readPulse(&pulse));
+  }
+  
+  // Decode loop of IRProtocol::rx(), one packet at a time
+  for (uint8_t run = 0; run < CYCLES_RUNS; ++run) {
+    uint32_t packet;
+    
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    pulses += pushGyropterPacket(seed & 0x1FFFFD);
+    
+    cyclesStart();
+    gyropter.poll(&packet);
+    cyclesAdd(&poll, cyclesStop());
+    
+    GyropterIRCommand gyroCommand;
+    
+    cyclesStart();
+    gyropter.getCommandPacket(&packet, &gyroCommand);
+    cyclesAdd(&command, cyclesStop());
+  }
+  
+  // Packet encoding, then its playback by the TX interrupt. The queue is
+  // drained after each packet, so none is coalesced with the previous one.
+  airswimmer.setSpeed(100);
+  airswimmer.prepareFlap(0);
+  
+  for (uint8_t run = 0; run < CYCLES_RUNS; ++run) {
+    cyclesStart();
+    airswimmer.sendPacket();
+    cyclesAdd(&sendPacket, cyclesStop());
+    
+    drainTx(&airswimmer, &txIsr);
+  }
+  
+  TIMSK1 = 0;
+  
+  // Scheduler dispatch with every task slot taken by an empty task, so
+  // each run picks the earliest due of COOP_MAX_TASKS tasks
+  for (uint8_t task = 0; task < COOP_MAX_TASKS; ++task) {
+    scheduler.add(cyclesEmptyTask, 1);
+  }
+  
+  for (uint8_t run = 0; run < CYCLES_RUNS; ++run) {
+    cyclesStart();
+    scheduler.run();
+    cyclesAdd(&dispatch, cyclesStop());
+  }
+  
+  consoleStat("isr_rx_edge", &rxIsr);
+  consoleStat("isr_tx_edge", &txIsr);
+  consoleStat("gyropter_poll_packet", &poll);
+  consoleValue("gyropter_poll_pulse", "_mean_cycles", poll.total / pulses);
+  consoleStat("gyropter_get_command_packet", &command);
+  consoleStat("airswimmer_send_packet", &sendPacket);
+  consoleStat("scheduler_run", &dispatch);
+  consoleValue("isr_worst", "_cycles", rxIsr.max > txIsr.max ? rxIsr.max : txIsr.max);
+  
+  // Sleeping with interrupts disabled ends the simulation
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop()
+{
+}
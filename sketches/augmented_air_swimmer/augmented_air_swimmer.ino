@@ -4,7 +4,8 @@
  * This sketch provides the ability to control an Air Swimmer
  * blimp (http://www.airswimmers.com/) with the controller 
  * from the Propel Gyropter remote-controlled helicopter
- * (http://amzn.com/B00481GIDA/).
+ * (http://amzn.com/B00481GIDA/). Two pilots can fly at once, on channels
+ * A and B of the Gyropter remote, each with their own Air Swimmer.
  *
  * This project serves as partial fulfillment of my Master's 
  * of Science in Computer Science at Rochester Institute of Technology. 
@@ -13,7 +14,7 @@
  * - Infrared Transmitter TX pin connected to Pin 3
  *   NOTE: The TX pin is hard-coded on Pin 3, and cannot be configured.
  * - Infrared Receiver RX pin connected to Pin 5
- *   NOTE: The rxPin variable can be modified to change the RX pin.
+ *   NOTE: The rxPin constant can be modified to change the RX pin.
  *
  * Created: 2013-03-24
  * Author: Ken Beck (http://geekken.net/)
@@ -25,94 +26,378 @@
 // when compiling the project: the IR and TimerOne libraries are not referenced directly
 // in this sketch, but referenced in the GyropterIR and AirSwimmerIR libraries.
 #include <IR.h>
+#include <IRMultiDecoder.h>
+#include <IRLatency.h>
+#include <IRCapture.h>
+#include <IRPower.h>
 #include <GyropterIR.h>
 #include <AirSwimmerIR.h>
+#include <AirSwimmerFleet.h>
+#include <CoopScheduler.h>
 
-#include <avr/io.h>
 #include <inttypes.h>
 
 // Configure the pin to use for receiving IR packets
-int rxPin = 5;
+const uint8_t rxPin = 5;
 
-// Buffers for storing incoming IR packets and the associated
-// Gyropter command structure
+// Number of Air Swimmers flown at once, from the first channels of the
+// remote in A/B/C order. Each Air Swimmer frame takes about half a gap on
+// the air, so the fleet only keeps two flying vehicles at the rate of a
+// lone remote (see AirSwimmerFleet).
+#define VEHICLE_COUNT 2
+
+// Time (in ms) for which the Air Swimmer's original remote keeps priority
+// over the Gyropter controller after one of its packets is received
+#define REMOTE_OVERRIDE_TIME 1000
+
+// Period (in us) of each task of the main loop (see CoopScheduler). The
+// command mapping task has none: it runs once the RX task has decoded a
+// Gyropter frame.
+#define RX_TASK_PERIOD        1000
+#define TX_TASK_PERIOD        1000
+#define SERIAL_TASK_PERIOD    10000
+#define TELEMETRY_TASK_PERIOD 1000000
+
+CoopScheduler scheduler;
+uint8_t rxTaskId;
+uint8_t mapTaskId;
+uint8_t txTaskId;
+uint8_t serialTaskId;
+uint8_t telemetryTaskId;
+
+// Buffers for storing incoming IR packets, the packets waiting to be mapped
+// and the last Gyropter command received on each channel (indexed by
+// GYROPTER_IR_CHANNEL_*)
 uint32_t inputPacketBuffer;
-GyropterIRCommand gyroCommand;
+uint32_t channelPackets[GYROPTER_IR_CHANNELS];
+uint8_t pendingChannels;
+GyropterIRCommand gyroCommands[GYROPTER_IR_CHANNELS];
+
+// The receiver hears both the Gyropter controller and the Air Swimmer's
+// original remote; both protocols are decoded from the same pulses
+IRMultiDecoder receiver;
+IRFrame frame;
+uint32_t lastRemoteTime;
+
+// Latency of each Gyropter command, from its frame to the first edge of the
+// Air Swimmer packet carrying it. Sending LATENCY_DUMP_COMMAND over serial
+// dumps the histograms (see IRLatency.h for the format).
+#define LATENCY_DUMP_COMMAND 'L'
+IRLatency latency;
+uint8_t latencyPacket;
+uint8_t latencyVehicle;
+uint8_t frameChannel;
+uint32_t frameStartTime;
+uint32_t frameEndTime;
+uint32_t decodedTime;
+
+// Sending CAPTURE_COMMAND over serial starts (or stops) streaming every
+// received pulse in the IRCapture format. Telemetry is not printed while
+// capturing, so the stream can be recorded as is.
+#define CAPTURE_COMMAND 'C'
+uint8_t captureEnabled;
+
+// When no task is due, the MCU sleeps until the next IR edge or timer tick.
+// Sending POWER_SAVE_COMMAND over serial turns this on or off.
+#define POWER_SAVE_COMMAND 'P'
+IRPower power;
+uint8_t powerSaveEnabled = 1;
+
+// The GyropterIR and AirSwimmerFleet library classes. They are allocated
+// statically, so their RAM is accounted for at link time, and started in
+// setup().
+GyropterIR gyropter(rxPin);
+AirSwimmerFleet airswimmers;
+
+// The Air Swimmer flown from each channel, in A/B/C order. The channel A
+// blimp answers to the default signature, the others to the following ones;
+// each blimp is paired with its signature by syncing it from its channel.
+// Frames from channels past VEHICLE_COUNT are ignored.
+AirSwimmerVehicle vehicles[VEHICLE_COUNT];
 
-// References to the GyropterIR and AirSwimmerIR library classes
-GyropterIR *gyropter;
-AirSwimmerIR *airswimmer;
+// Air Swimmer of each channel, indexed by GYROPTER_IR_CHANNEL_*
+const uint8_t channelVehicles[GYROPTER_IR_CHANNELS] = {
+  0,  // A
+  2,  // C
+  1   // B
+};
 
 /**
- * Initialize the core libraries for this sketch
- */ 
-void setup() 
+ * Pulse tap streaming the received pulses in capture mode
+ */
+void capturePulse(uint16_t pulse)
 {
-  gyropter = new GyropterIR(rxPin);
-  airswimmer = new AirSwimmerIR();
-//   Serial.begin(9600);
+  uint8_t record[IR_CAPTURE_MAX_RECORD];
+  
+  Serial.write(record, IRCapture::encode(pulse, record));
 }
 
 /**
- * Handles the main logic for the program. Steps:
- * - Read an incoming IR packet from the Gyropter remote
- * - Convert packet to a Gyropter command packet
+ * Applies a Gyropter packet to the Air Swimmer of its channel. Steps:
+ * - Convert packet to a Gyropter command packet, in the slot of its channel
  * - Listen for sync command (zero throttle with light button depressed)
- *   - If sync command found, configure Air Swimmer library to send sync packet
- *   - Otherwise, configure Air Swimmer library with current command configuration
+ *   - If sync command found, configure the channel's Air Swimmer to send sync packets
+ *   - Otherwise, configure the channel's Air Swimmer with current command configuration
+ *
+ * @param channel Channel of the packet (see GYROPTER_IR_CHANNEL_*)
+ * @return Boolean indicating whether a flight command was applied
  */
-void loop() 
+uint8_t applyCommand(uint8_t channel)
 {
-  // Read an incoming Gyropter IR packet. This command times out after 200ms, if no 
-  // commands are received.
-  if (gyropter->rx(&inputPacketBuffer, 200)) {
-    // Convert the Gyropter IR packet to a command packet. This is simpler to work with,
-    // as it abstracts away the specific packet structure into one specific for use with
-    // the Air Swimmers library.
-    gyropter->getCommandPacket(&inputPacketBuffer, &gyroCommand);
-       
-    // Detect the sync command, which corresponds to a throttle set to 0 and 
-    // the light button depressed
-    if (gyroCommand.throttlePercent == 0 && gyroCommand.lightToggle == 1) {
-      // Send sync command
-      airswimmer->prepareSync(1);
-      
-      // If we're currently pairing with a blimp, we do not want to perform any other 
-      // commands, so we drop out of the main loop.
-      return;
+  GyropterIRCommand *gyroCommand = &gyroCommands[channel];
+  AirSwimmerVehicle *airswimmer = &vehicles[channelVehicles[channel]];
+  
+  // Convert the Gyropter IR packet to a command packet. This is simpler to work with,
+  // as it abstracts away the specific packet structure into one specific for use with
+  // the Air Swimmers library.
+  gyropter.getCommandPacket(&channelPackets[channel], gyroCommand);
+     
+  // Detect the sync command, which corresponds to a throttle set to 0 and 
+  // the light button depressed
+  if (gyroCommand->throttlePercent == 0 && gyroCommand->lightToggle == 1) {
+    // Send sync command
+    airswimmer->prepareSync(1);
+    
+    // If we're currently pairing with a blimp, we do not want to perform any other 
+    // commands.
+    return 0;
+  }
+  
+  // Disable sync packet
+  airswimmer->prepareSync(0);
+ 
+  // Configure the flap direction for the Air Swimmer library
+  if (gyroCommand->leftPercent > 0) {
+    // Sets the library to send a 'flap left' command
+    airswimmer->prepareFlap(-1);
+  } else if (gyroCommand->rightPercent > 0) {
+     // Sets the library to send a 'flap right' command
+     airswimmer->prepareFlap(1); 
+  } else {
+     // Sets the library to toggle between 'flap left' and 'flap right'
+     airswimmer->prepareFlap(0); 
+  }
+  
+  // Configure the 'dive' command for the Air Swimmer library
+  if (gyroCommand->upPercent > 0) {
+    // Sets the library to send the 'climb' command
+    airswimmer->prepareDive(-1);
+  } else if (gyroCommand->downPercent > 0) {
+    // Sets the library to send the 'dive' command
+    airswimmer->prepareDive(1);
+  } else {
+    // Disables diving
+    airswimmer->prepareDive(0); 
+  }
+  
+  // Set the throttle percent for the Air Swimmer library
+  airswimmer->setSpeed(gyroCommand->throttlePercent);
+  
+  return 1;
+}
+
+/**
+ * RX task. Steps:
+ * - Decode any IR pulses received since the last run, from either the Gyropter
+ *   remote or the Air Swimmer's original remote
+ * - Ignore the Gyropter remote while the original remote is in use
+ * - Hand Gyropter packets over to the command mapping task, in the slot of
+ *   their channel
+ */
+void rxTask()
+{
+  // Decode the pulses captured since the last run. Pulses are captured by an
+  // interrupt, so an incomplete packet is finished on a later run.
+  while (receiver.poll(&gyropter, &frame)) {
+    // Packets from the original remote give it priority over the Gyropter remote.
+    // The receiver also hears our own packets, which are told apart by their
+    // contents: the fleet transmits almost all the time.
+    if (frame.protocol == AIRSWIMMER_IR_PROTOCOL) {
+      if (!airswimmers.isEcho(&frame.packet)) {
+        lastRemoteTime = millis();
+      }
+      continue;
     }
     
-    // Disable sync packet
-    airswimmer->prepareSync(0);
-   
-    // Configure the flap direction for the Air Swimmer library
-    if (gyroCommand.leftPercent > 0) {
-      // Sets the library to send a 'flap left' command
-      airswimmer->prepareFlap(-1);
-    } else if (gyroCommand.rightPercent > 0) {
-       // Sets the library to send a 'flap right' command
-       airswimmer->prepareFlap(1); 
-    } else {
-       // Sets the library to toggle between 'flap left' and 'flap right'
-       airswimmer->prepareFlap(0); 
+    if (lastRemoteTime && millis() - lastRemoteTime < REMOTE_OVERRIDE_TIME) {
+      continue;
     }
     
-    // Configure the 'dive' command for the Air Swimmer library
-    if (gyroCommand.upPercent > 0) {
-      // Sets the library to send the 'climb' command
-      airswimmer->prepareDive(-1);
-      Serial.println("Climbing??");
-    } else if (gyroCommand.downPercent > 0) {
-      // Sets the library to send the 'dive' command
-      airswimmer->prepareDive(1);
-      Serial.println("Diving??");
-    } else {
-      // Disables diving
-      airswimmer->prepareDive(0); 
+    inputPacketBuffer = frame.packet;
+    
+    // Frames from each channel only drive that channel's Air Swimmer
+    uint8_t channel = GyropterIR::getChannel(&inputPacketBuffer);
+    
+    if (channel == GYROPTER_IR_CHANNELS || channelVehicles[channel] >= VEHICLE_COUNT) {
+      continue;
     }
     
-    // Set the throttle percent for the Air Swimmer library
-    airswimmer->setSpeed(gyroCommand.throttlePercent);
+    channelPackets[channel] = inputPacketBuffer;
+    pendingChannels |= _BV(channel);
+    
+    frameChannel = channel;
+    frameEndTime = gyropter.getPulseEndTime();
+    frameStartTime = frameEndTime - GyropterIR::getPacketDuration(&frame.packet);
+    decodedTime = micros();
+    
+    scheduler.wake(mapTaskId);
+  }
+}
+
+/**
+ * Command mapping task. Applies the last packet received on each channel
+ * to the channel's Air Swimmer.
+ */
+void mapTask()
+{
+  for (uint8_t channel = 0; channel < GYROPTER_IR_CHANNELS; ++channel) {
+    if (!(pendingChannels & _BV(channel))) {
+      continue;
+    }
+    
+    pendingChannels &= ~_BV(channel);
+    
+    if (applyCommand(channel) && channel == frameChannel) {
+      latencyVehicle = channelVehicles[channel];
+      latency.begin(frameStartTime);
+      latency.mark(IR_LATENCY_FRAME_END, frameEndTime);
+      latency.mark(IR_LATENCY_DECODED, decodedTime);
+      latency.mark(IR_LATENCY_APPLIED, micros());
+    }
   }
 }
 
+/**
+ * TX task. Queues the next Air Swimmer packets that are due, and tracks the
+ * latency of the last command. Packets are sent by the TX interrupt.
+ */
+void txTask()
+{
+  uint8_t vehicleCount = airswimmers.getVehicleTxCount(latencyVehicle);
+  airswimmers.update();
+  
+  // Follow the last command applied to the first packet of its Air Swimmer
+  // (the vehicles were added in order)
+  if (latency.getStage() == IR_LATENCY_QUEUED && airswimmers.getVehicleTxCount(latencyVehicle) != vehicleCount) {
+    latencyPacket = airswimmers.getVehicleTxCount(latencyVehicle);
+    latency.mark(IR_LATENCY_QUEUED, micros());
+  }
+  
+  if (latency.getStage() == IR_LATENCY_EMITTED) {
+    uint32_t startTime;
+    
+    if (airswimmers.getTxStart(&startTime) == latencyPacket) {
+      latency.mark(IR_LATENCY_EMITTED, startTime);
+    }
+  }
+}
+
+/**
+ * Serial task. Dumps the latency histograms, and starts or stops the
+ * capture of received pulses, when requested.
+ */
+void serialTask()
+{
+  if (!Serial.available()) {
+    return;
+  }
+  
+  switch (Serial.read()) {
+    case LATENCY_DUMP_COMMAND:
+      latency.dump(Serial);
+      break;
+      
+    case CAPTURE_COMMAND:
+      captureEnabled = !captureEnabled;
+      
+      if (captureEnabled) {
+        IRCapture::writeHeader(Serial);
+        gyropter.setPulseTap(capturePulse);
+      } else {
+        gyropter.setPulseTap(0);
+      }
+      break;
+      
+    case POWER_SAVE_COMMAND:
+      powerSaveEnabled = !powerSaveEnabled;
+      power.resetStats();
+      break;
+  }
+}
+
+/**
+ * Telemetry task. Prints the longest task run (and so loop pass), the
+ * latest RX task start, and the load of the Air Swimmer fleet, unless the
+ * serial port carries a capture.
+ */
+void telemetryTask()
+{
+  CoopTaskStats rxStats;
+  AirSwimmerFleetStats fleetStats;
+  IRPowerStats powerStats;
+  
+  if (captureEnabled) {
+    return;
+  }
+  
+  scheduler.getStats(rxTaskId, &rxStats);
+  airswimmers.getStats(&fleetStats);
+  power.getStats(&powerStats);
+  
+  Serial.print("loop_max_us ");
+  Serial.print((long)scheduler.getMaxRunTime());
+  Serial.print(" rx_late_us ");
+  Serial.print((long)rxStats.maxLateUs);
+  Serial.print(" fleet_load ");
+  Serial.print((long)fleetStats.load);
+  Serial.print(" fleet_late ");
+  Serial.print((long)fleetStats.lateFrames);
+  Serial.print(" awake_permille ");
+  Serial.print((long)power.getDutyCycle());
+  Serial.print(" wakes_rx ");
+  Serial.print((long)powerStats.rxWakes);
+  Serial.print(" wakes_tx ");
+  Serial.print((long)powerStats.txWakes);
+  Serial.print(" wakes_timer ");
+  Serial.println((long)powerStats.timerWakes);
+}
+
+/**
+ * Initialize the core libraries and the tasks of this sketch
+ */ 
+void setup() 
+{
+  gyropter.begin();
+  airswimmers.begin();
+  
+  for (uint8_t vehicle = 0; vehicle < VEHICLE_COUNT; ++vehicle) {
+    vehicles[vehicle].setSignature(AIRSWIMMER_IR_SIGNATURE + vehicle);
+    airswimmers.add(&vehicles[vehicle]);
+  }
+  
+  // The Air Swimmer library does not receive, so its decoder is free to
+  // decode the original remote
+  receiver.add(gyropter.getDecoder(), GYROPTER_IR_PROTOCOL);
+  receiver.add(airswimmers.getDecoder(), AIRSWIMMER_IR_PROTOCOL);
+  Serial.begin(115200);
+  
+  rxTaskId = scheduler.add(rxTask, RX_TASK_PERIOD);
+  mapTaskId = scheduler.add(mapTask, 0);
+  txTaskId = scheduler.add(txTask, TX_TASK_PERIOD);
+  serialTaskId = scheduler.add(serialTask, SERIAL_TASK_PERIOD);
+  telemetryTaskId = scheduler.add(telemetryTask, TELEMETRY_TASK_PERIOD);
+  
+  power.begin();
+}
+
+/**
+ * Runs the task due first, if any. Every task runs to completion, so a
+ * pass lasts no longer than the longest task. When no task is due, sleeps
+ * until the next interrupt.
+ */
+void loop() 
+{
+  if (!scheduler.run() && powerSaveEnabled) {
+    power.sleep();
+  }
+}